@@ -20,40 +20,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iv.h>
-#include <iv_tls.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include "iv_getaddrinfo.h"
 
-struct iv_getaddrinfo_thr_info {
-	int			num_requests;
-	struct iv_work_pool	pool;
-};
+/*
+ * All threads share a single process-wide lookup pool, so that the
+ * total number of resolver threads doesn't scale with the number of
+ * threads doing lookups.  Each lookup's completion is delivered back
+ * to the thread that submitted it.
+ */
+static pthread_once_t iv_getaddrinfo_pool_once = PTHREAD_ONCE_INIT;
+static struct iv_work_pool iv_getaddrinfo_pool;
+static int iv_getaddrinfo_pool_ret;
 
-static void iv_getaddrinfo_tls_init_thread(void *_tinfo)
+static void iv_getaddrinfo_pool_create(void)
 {
-	struct iv_getaddrinfo_thr_info *tinfo = _tinfo;
-
-	tinfo->num_requests = 0;
+	IV_WORK_POOL_INIT(&iv_getaddrinfo_pool);
+	iv_getaddrinfo_pool.max_threads = 100;
+	iv_getaddrinfo_pool.cookie = NULL;
+	iv_getaddrinfo_pool.shared = 1;
 
-	IV_WORK_POOL_INIT(&tinfo->pool);
-	tinfo->pool.max_threads = 100;
-	tinfo->pool.cookie = NULL;
-	tinfo->pool.thread_start = NULL;
-	tinfo->pool.thread_stop = NULL;
-}
-
-static struct iv_tls_user iv_getaddrinfo_tls_user = {
-	.sizeof_state	= sizeof(struct iv_getaddrinfo_thr_info),
-	.init_thread	= iv_getaddrinfo_tls_init_thread,
-};
-
-static void iv_getaddrinfo_tls_init(void) __attribute__((constructor));
-static void iv_getaddrinfo_tls_init(void)
-{
-	iv_tls_user_register(&iv_getaddrinfo_tls_user);
+	iv_getaddrinfo_pool_ret = iv_work_pool_create(&iv_getaddrinfo_pool);
 }
 
 
@@ -79,31 +70,36 @@ static void iv_getaddrinfo_task_work(void *_igt)
 			       igt->have_hints ? &igt->hints : NULL, &igt->res);
 }
 
+static void iv_getaddrinfo_task_free(struct iv_getaddrinfo_task *igt)
+{
+	free(igt->node);
+	free(igt->service);
+	free(igt);
+}
+
 static void iv_getaddrinfo_task_complete(void *_igt)
 {
 	struct iv_getaddrinfo_task *igt = _igt;
 	struct iv_getaddrinfo *ig;
-	struct iv_getaddrinfo_thr_info *tinfo;
 
 	ig = igt->ig;
-	if (ig != NULL)
+	if (ig != NULL) {
+		ig->task = NULL;
 		ig->handler(ig->cookie, igt->ret, igt->res);
-	else
+	} else if (igt->res != NULL) {
 		freeaddrinfo(igt->res);
+	}
 
-	free(igt->node);
-	free(igt->service);
-	free(igt);
-
-	tinfo = iv_tls_user_ptr(&iv_getaddrinfo_tls_user);
-	if (!--tinfo->num_requests)
-		iv_work_pool_put(&tinfo->pool);
+	iv_getaddrinfo_task_free(igt);
 }
 
 int iv_getaddrinfo_submit(struct iv_getaddrinfo *ig)
 {
 	struct iv_getaddrinfo_task *igt;
-	struct iv_getaddrinfo_thr_info *tinfo;
+
+	pthread_once(&iv_getaddrinfo_pool_once, iv_getaddrinfo_pool_create);
+	if (iv_getaddrinfo_pool_ret < 0)
+		return -1;
 
 	igt = calloc(1, sizeof(*igt));
 	if (igt == NULL)
@@ -142,19 +138,26 @@ int iv_getaddrinfo_submit(struct iv_getaddrinfo *ig)
 		igt->have_hints = 1;
 	}
 
-	tinfo = iv_tls_user_ptr(&iv_getaddrinfo_tls_user);
-	if (!tinfo->num_requests++)
-		iv_work_pool_create(&tinfo->pool);
+	iv_work_pool_submit_work(&iv_getaddrinfo_pool, &igt->work);
 
-	iv_work_pool_submit_work(&tinfo->pool, &igt->work);
+	ig->task = igt;
 
 	return 0;
 }
 
 void iv_getaddrinfo_cancel(struct iv_getaddrinfo *ig)
 {
-	struct iv_getaddrinfo_task *t = ig->task;
+	struct iv_getaddrinfo_task *igt = ig->task;
 
 	ig->task = NULL;
-	t->ig = NULL;
+
+	/*
+	 * If the lookup hasn't been picked up by a pool thread yet,
+	 * take it off the queue altogether.  Otherwise, let it run
+	 * to completion, and discard the result when it comes in.
+	 */
+	if (!iv_work_pool_cancel(&igt->work, IV_WORK_CANCEL_FLAG_SILENT))
+		iv_getaddrinfo_task_free(igt);
+	else
+		igt->ig = NULL;
 }
@@ -0,0 +1,76 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __IV_LISTENER_H
+#define __IV_LISTENER_H
+
+#include <iv.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct iv_listener {
+	int			fd;
+	void			*cookie;
+	void			(*handler)(void *cookie, int fd);
+	int			max_conns;
+	int			low_conns;
+	int			max_latency;
+	int			low_latency;
+	int			shed;
+	const void		*reject_msg;
+	int			reject_len;
+
+	struct iv_fd		ivfd;
+	struct iv_timer		sample_timer;
+	struct iv_timer		retry_timer;
+	int			conns;
+	int			latency;
+	int			idle_samples;
+	int			saturated;
+	int			backoff;
+};
+
+#define IV_LISTENER_SHED_NONE		0
+#define IV_LISTENER_SHED_CLOSE		1
+#define IV_LISTENER_SHED_REJECT		2
+
+static inline void IV_LISTENER_INIT(struct iv_listener *this)
+{
+	this->max_conns = 0;
+	this->low_conns = 0;
+	this->max_latency = 0;
+	this->low_latency = 0;
+	this->shed = IV_LISTENER_SHED_NONE;
+	this->reject_msg = NULL;
+	this->reject_len = 0;
+}
+
+void iv_listener_register(struct iv_listener *this);
+void iv_listener_unregister(struct iv_listener *this);
+void iv_listener_conn_closed(struct iv_listener *this);
+int iv_listener_saturated(struct iv_listener *this);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
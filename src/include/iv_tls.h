@@ -36,9 +36,15 @@ struct iv_tls_user {
 	int			state_offset;
 };
 
+#define IV_TLS_CACHELINE_SIZE	64
+
 void iv_tls_user_register(struct iv_tls_user *);
+void iv_tls_user_register_aligned(struct iv_tls_user *, int align);
 void *iv_tls_user_ptr(struct iv_tls_user *);
 
+struct iv_loop;
+void *iv_loop_tls_user_ptr(struct iv_loop *, struct iv_tls_user *);
+
 #ifdef __cplusplus
 }
 #endif
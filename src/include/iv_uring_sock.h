@@ -0,0 +1,69 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __IV_URING_SOCK_H
+#define __IV_URING_SOCK_H
+
+#include <iv.h>
+#include <iv_list.h>
+#include <sys/socket.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct iv_uring_req;
+
+struct iv_uring_sock {
+	int			fd;
+	void			*cookie;
+	void			(*handler_recv)(void *cookie, void *buf, int len);
+	void			(*handler_send)(void *cookie, int ret);
+	void			(*handler_accept)(void *cookie, int fd);
+	void			(*handler_connect)(void *cookie, int ret);
+
+	void			*tinfo;
+	struct iv_uring_req	*recv_req;
+	struct iv_uring_req	*accept_req;
+	struct iv_uring_req	*connect_req;
+	struct iv_list_head	sends;
+};
+
+static inline void IV_URING_SOCK_INIT(struct iv_uring_sock *this)
+{
+	this->handler_recv = NULL;
+	this->handler_send = NULL;
+	this->handler_accept = NULL;
+	this->handler_connect = NULL;
+}
+
+int iv_uring_sock_register(struct iv_uring_sock *this);
+void iv_uring_sock_unregister(struct iv_uring_sock *this);
+int iv_uring_sock_recv(struct iv_uring_sock *this);
+int iv_uring_sock_send(struct iv_uring_sock *this, const void *buf, int len);
+int iv_uring_sock_accept(struct iv_uring_sock *this);
+int iv_uring_sock_connect(struct iv_uring_sock *this,
+			  const struct sockaddr *addr, socklen_t addrlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif
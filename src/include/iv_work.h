@@ -22,43 +22,165 @@
 #define __IV_WORK_H
 
 #include <iv.h>
+#include <iv_avl.h>
 #include <iv_list.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+struct iv_work_item;
+
 struct iv_work_pool {
 	int		max_threads;
 	void		*cookie;
 	void		(*thread_start)(void *cookie);
 	void		(*thread_stop)(void *cookie);
+	int		max_completions;
+	void		(*completion_batch)(void *cookie,
+					    struct iv_work_item **items,
+					    int num_items);
+	int		min_threads;
+	int		idle_timeout;
+	int		max_queue_latency;
+	int		lightweight;
+	int		shared;
+	int		max_queue_depth;
+	int		queue_policy;
+	int		queue_low_watermark;
+	void		(*space_available)(void *cookie);
 
 	void		*priv;
 };
 
+#define IV_WORK_QUEUE_REJECT		0
+#define IV_WORK_QUEUE_DROP_OLDEST	1
+#define IV_WORK_QUEUE_NOTIFY		2
+
+#define IV_WORK_PRIORITY_LOW		0
+#define IV_WORK_PRIORITY_NORMAL		1
+#define IV_WORK_PRIORITY_HIGH		2
+
+#define IV_WORK_STATUS_DONE		0
+#define IV_WORK_STATUS_EXPIRED		1
+#define IV_WORK_STATUS_CANCELLED	2
+#define IV_WORK_STATUS_OVERRUN		3
+#define IV_WORK_STATUS_DROPPED		4
+
+#define IV_WORK_CANCEL_FLAG_SILENT	1
+
 struct iv_work_item {
 	void			*cookie;
 	void			(*work)(void *cookie);
 	void			(*completion)(void *cookie);
+	int			priority;
+	struct timespec		deadline;
+	int			timeout;
+	int			status;
 
 	struct iv_list_head	list;
+	struct iv_avl_node	avl_node;
+	struct timespec		submitted;
+	void			*pool;
+	int			queued;
+	unsigned int		seq;
+	void			*owner;
+	void			*group;
+};
+
+struct iv_work_group {
+	void			*cookie;
+	void			(*completion)(void *cookie);
+
+	void			*pool;
+	int			forked;
+	int			joined;
+	int			pending;
+	struct iv_work_item	done;
+	void			*range;
+};
+
+#ifndef _WIN32
+struct iv_work_fd {
+	int			fd;
+	void			*cookie;
+	void			(*handler)(void *cookie, int bands);
+	void			(*completion)(void *cookie);
+	int			bands;
+
+	struct iv_fd		ivfd;
+	struct iv_work_item	work;
+	struct iv_work_pool	*pool;
+	int			ready_bands;
+	int			running;
 };
+#endif
 
 static inline void IV_WORK_POOL_INIT(struct iv_work_pool *this)
 {
 	this->thread_start = NULL;
 	this->thread_stop = NULL;
+	this->max_completions = 0;
+	this->completion_batch = NULL;
+	this->min_threads = 0;
+	this->idle_timeout = 0;
+	this->max_queue_latency = 0;
+	this->lightweight = 0;
+	this->shared = 0;
+	this->max_queue_depth = 0;
+	this->queue_policy = IV_WORK_QUEUE_REJECT;
+	this->queue_low_watermark = 0;
+	this->space_available = NULL;
 }
 
 static inline void IV_WORK_ITEM_INIT(struct iv_work_item *this)
 {
+	this->priority = IV_WORK_PRIORITY_NORMAL;
+	this->deadline.tv_sec = 0;
+	this->deadline.tv_nsec = 0;
+	this->timeout = 0;
+	this->status = IV_WORK_STATUS_DONE;
+	this->pool = NULL;
+	this->queued = 0;
+	this->group = NULL;
+}
+
+static inline void IV_WORK_GROUP_INIT(struct iv_work_group *this)
+{
+	this->pool = NULL;
+	this->forked = 0;
+	this->joined = 0;
+	this->pending = 1;
+	this->range = NULL;
+}
+
+#ifndef _WIN32
+static inline void IV_WORK_FD_INIT(struct iv_work_fd *this)
+{
+	this->fd = -1;
+	this->completion = NULL;
+	this->bands = IV_FD_BAND_IN;
+	this->running = 0;
 }
+#endif
 
 int iv_work_pool_create(struct iv_work_pool *this);
 void iv_work_pool_put(struct iv_work_pool *this);
-void iv_work_pool_submit_work(struct iv_work_pool *this,
-			      struct iv_work_item *work);
+int iv_work_pool_submit_work(struct iv_work_pool *this,
+			     struct iv_work_item *work);
+int iv_work_pool_submit_batch(struct iv_work_pool *this,
+			      struct iv_work_item **items, int num_items);
+int iv_work_pool_cancel(struct iv_work_item *work, int flags);
+void iv_work_group_fork(struct iv_work_pool *this, struct iv_work_group *group,
+			struct iv_work_item *work);
+void iv_work_group_join(struct iv_work_group *group);
+int iv_work_parallel_for(struct iv_work_pool *this,
+			 struct iv_work_group *group, int begin, int end,
+			 int grain, void (*fn)(void *cookie, int begin, int end));
+#ifndef _WIN32
+void iv_work_fd_register(struct iv_work_pool *this, struct iv_work_fd *wfd);
+int iv_work_fd_unregister(struct iv_work_fd *wfd);
+#endif
 
 #ifdef __cplusplus
 }
@@ -34,7 +34,13 @@ struct iv_event_thr_info {
 		struct iv_event_raw	ier;
 		struct iv_state		*st;
 	} u;
-	__mutex_t		list_mutex;
+
+	/*
+	 * Written by the threads that post events to this thread, so
+	 * kept on cache lines of their own.
+	 */
+	__mutex_t		list_mutex
+		__attribute__((aligned(IV_TLS_CACHELINE_SIZE)));
 	struct iv_list_head	pending_events;
 };
 
@@ -90,7 +96,8 @@ static struct iv_tls_user iv_event_tls_user = {
 static void iv_event_tls_init(void) __attribute__((constructor));
 static void iv_event_tls_init(void)
 {
-	iv_tls_user_register(&iv_event_tls_user);
+	iv_tls_user_register_aligned(&iv_event_tls_user,
+				     IV_TLS_CACHELINE_SIZE);
 }
 
 void iv_event_run_pending_events(void)
@@ -27,41 +27,108 @@
 #include "iv_private.h"
 #include "iv_fd_private.h"
 
+#ifdef STATIC_POLL_METHOD
+#include STATIC_POLL_METHOD_SOURCE
+#endif
+
 /* internal use *************************************************************/
 int				maxfd;
-struct iv_fd_poll_method	*method;
+#ifdef STATIC_POLL_METHOD
+const struct iv_fd_poll_method	*method = &STATIC_POLL_METHOD;
+#define method			(&STATIC_POLL_METHOD)
+#else
+const struct iv_fd_poll_method	*method;
+#endif
 
-static void sanitise_nofile_rlimit(int euid)
+/*
+ * The number of file descriptors that we try to raise RLIMIT_NOFILE
+ * to, which defaults to the kernel's per-process maximum.  Per-loop
+ * structures are sized by the number of registered fds rather than
+ * by this limit, so a high limit costs nothing until it is used.
+ */
+static int fd_limit;
+
+static int default_fd_limit(void)
+{
+#ifdef __linux__
+	FILE *fp;
+	int limit;
+
+	fp = fopen("/proc/sys/fs/nr_open", "re");
+	if (fp != NULL) {
+		if (fscanf(fp, "%d", &limit) != 1)
+			limit = 0;
+		fclose(fp);
+
+		if (limit > 0)
+			return limit;
+	}
+#endif
+
+	return 1048576;
+}
+
+static int rlim_to_int(rlim_t lim)
+{
+	if (lim == RLIM_INFINITY || lim > 0x7FFFFFFF)
+		return 0x7FFFFFFF;
+
+	return lim;
+}
+
+static void update_maxfd(void)
 {
 	struct rlimit lim;
 
-	getrlimit(RLIMIT_NOFILE, &lim);
-	maxfd = lim.rlim_cur;
+	if (getrlimit(RLIMIT_NOFILE, &lim) >= 0)
+		maxfd = rlim_to_int(lim.rlim_cur);
+}
 
-	if (euid) {
-		if (lim.rlim_cur < lim.rlim_max) {
-			lim.rlim_cur = (unsigned int)lim.rlim_max & 0x7FFFFFFF;
-			if (lim.rlim_cur > 131072)
-				lim.rlim_cur = 131072;
+static void sanitise_nofile_rlimit(int euid)
+{
+	struct rlimit lim;
+	int limit;
 
-			if (setrlimit(RLIMIT_NOFILE, &lim) >= 0)
-				maxfd = lim.rlim_cur;
-		}
-	} else {
-		lim.rlim_cur = 131072;
-		lim.rlim_max = 131072;
-		while (lim.rlim_cur > maxfd) {
-			if (setrlimit(RLIMIT_NOFILE, &lim) >= 0) {
-				maxfd = lim.rlim_cur;
-				break;
+	limit = fd_limit ? fd_limit : default_fd_limit();
+
+	getrlimit(RLIMIT_NOFILE, &lim);
+	maxfd = rlim_to_int(lim.rlim_cur);
+
+	if (maxfd >= limit)
+		return;
+
+	/*
+	 * If we are root, try raising the hard limit as well, backing
+	 * off if the kernel won't let us go that high.
+	 */
+	if (!euid && rlim_to_int(lim.rlim_max) < limit) {
+		struct rlimit hard;
+
+		hard.rlim_cur = limit;
+		hard.rlim_max = limit;
+		while (hard.rlim_max > lim.rlim_max) {
+			if (setrlimit(RLIMIT_NOFILE, &hard) >= 0) {
+				maxfd = hard.rlim_cur;
+				return;
 			}
 
-			lim.rlim_cur /= 2;
-			lim.rlim_max /= 2;
+			hard.rlim_cur /= 2;
+			hard.rlim_max /= 2;
 		}
 	}
+
+	if (lim.rlim_cur < lim.rlim_max) {
+		if (rlim_to_int(lim.rlim_max) > limit)
+			lim.rlim_cur = limit;
+		else
+			lim.rlim_cur = lim.rlim_max;
+
+		if (setrlimit(RLIMIT_NOFILE, &lim) >= 0)
+			maxfd = rlim_to_int(lim.rlim_cur);
+	}
 }
 
+#ifndef STATIC_POLL_METHOD
 static int method_is_excluded(char *exclude, char *name)
 {
 	if (exclude != NULL) {
@@ -79,7 +146,7 @@ static int method_is_excluded(char *exclude, char *name)
 }
 
 static void consider_poll_method(struct iv_state *st, char *exclude,
-				 struct iv_fd_poll_method *m)
+				 const struct iv_fd_poll_method *m)
 {
 	if (method == NULL && !method_is_excluded(exclude, m->name)) {
 		if (m->init(st) >= 0)
@@ -87,18 +154,10 @@ static void consider_poll_method(struct iv_state *st, char *exclude,
 	}
 }
 
-static void iv_fd_init_first_thread(struct iv_state *st)
+static void iv_fd_select_poll_method(struct iv_state *st, int euid)
 {
-	int euid;
 	char *exclude;
 
-	euid = geteuid();
-
-	signal(SIGPIPE, SIG_IGN);
-	signal(SIGURG, SIG_IGN);
-
-	sanitise_nofile_rlimit(euid);
-
 	exclude = getenv("IV_EXCLUDE_POLL_METHOD");
 	if (exclude != NULL && getuid() != euid)
 		exclude = NULL;
@@ -120,16 +179,46 @@ static void iv_fd_init_first_thread(struct iv_state *st)
 	if (method == NULL)
 		iv_fatal("iv_init: can't find suitable event dispatcher");
 }
+#endif
+
+static void iv_fd_init_first_thread(struct iv_state *st)
+{
+	int euid;
+
+	euid = geteuid();
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGURG, SIG_IGN);
+
+	sanitise_nofile_rlimit(euid);
+
+#ifndef STATIC_POLL_METHOD
+	iv_fd_select_poll_method(st, euid);
+#else
+	if (method->init(st) < 0)
+		iv_fatal("iv_init: can't initialize event dispatcher");
+#endif
+}
+
+static void iv_fd_run_speculative(void *_st);
+static int iv_fd_handler_bands(struct iv_fd_ *fd);
+static void notify_fd(struct iv_state *st, struct iv_fd_ *fd);
 
 void iv_fd_init(struct iv_state *st)
 {
-	if (method == NULL)
+	if (!maxfd)
 		iv_fd_init_first_thread(st);
 	else if (method->init(st) < 0)
 		iv_fatal("iv_init: can't initialize event dispatcher");
 
 	st->numfds = 0;
 	st->handled_fd = NULL;
+	INIT_IV_LIST_HEAD(&st->fds_deferred);
+	st->fd_budget = 0;
+	INIT_IV_LIST_HEAD(&st->fds_speculative);
+	IV_TASK_INIT(&st->fd_speculative_task);
+	st->fd_speculative_task.cookie = st;
+	st->fd_speculative_task.handler = iv_fd_run_speculative;
 }
 
 void iv_fd_deinit(struct iv_state *st)
@@ -137,35 +226,243 @@ void iv_fd_deinit(struct iv_state *st)
 	method->deinit(st);
 }
 
-void iv_fd_poll_and_run(struct iv_state *st, struct timespec *to)
+/*
+ * Bands of speculative fds that haven't been reported as blocking
+ * yet are dispatched again from a task in the next loop iteration.
+ * This is done before calling the fd's handlers, as the fd can be
+ * unregistered and freed by its handlers.
+ */
+static void iv_fd_queue_speculative(struct iv_state *st, struct iv_fd_ *fd)
+{
+	if (fd->speculative_bands && !fd->disarmed) {
+		iv_fd_make_ready(&st->fds_speculative, fd,
+				 fd->speculative_bands);
+		if (!iv_task_registered(&st->fd_speculative_task)) {
+			iv_loop_task_register(iv_state_to_loop(st),
+					      &st->fd_speculative_task);
+		}
+	}
+}
+
+#define GROUP_BATCH	64
+
+static void iv_fd_run_groups(struct iv_state *st, struct iv_list_head *groups)
+{
+	while (!iv_list_empty(groups)) {
+		struct iv_fd_group_ *group;
+
+		group = iv_list_entry(groups->next, struct iv_fd_group_,
+				      list_active);
+		iv_list_del_init(&group->list_active);
+
+		/*
+		 * Take member fds off the group's ready list one batch
+		 * at a time, so that member fds that are unregistered
+		 * by the handler while processing an earlier batch
+		 * won't be reported in a later batch.
+		 */
+		while (!iv_list_empty(&group->ready)) {
+			struct iv_fd_ready ready[GROUP_BATCH];
+			int num;
+
+			num = 0;
+			while (num < GROUP_BATCH &&
+			       !iv_list_empty(&group->ready)) {
+				struct iv_fd_ *fd;
+
+				fd = iv_list_entry(group->ready.next,
+						   struct iv_fd_, list_active);
+				iv_list_del_init(&fd->list_active);
+				fd->group_ready = 0;
+
+				ready[num].cookie = fd->cookie;
+				ready[num].bands = fd->ready_bands &
+						   iv_fd_handler_bands(fd);
+				if (ready[num].bands)
+					num++;
+
+				iv_fd_queue_speculative(st, fd);
+			}
+
+			if (num)
+				group->handler(group->cookie, ready, num);
+		}
+	}
+}
+
+static void iv_fd_dispatch(struct iv_state *st, struct iv_list_head *groups,
+			   struct iv_fd_ *fd)
+{
+	int bands;
+
+	/*
+	 * Don't dispatch, and in particular don't disarm, an fd
+	 * that has nothing to deliver, such as a speculative fd
+	 * whose bands were all reported as blocking after it was
+	 * queued, as nothing would re-arm a oneshot fd after that.
+	 * If the poll method parked the fd upon delivering the
+	 * event, such as for a bare error condition reported to a
+	 * handler that only watches for RDHUP or PRI, have it re-arm
+	 * the fd instead.
+	 */
+	bands = fd->ready_bands & iv_fd_handler_bands(fd);
+	if (!bands) {
+		if (fd->parked)
+			notify_fd(st, fd);
+		return;
+	}
+
+	if (fd->oneshot) {
+		if (fd->disarmed)
+			return;
+
+		fd->disarmed = 1;
+		notify_fd(st, fd);
+	}
+
+	if (fd->group != NULL) {
+		struct iv_fd_group_ *group = fd->group;
+
+		if (iv_list_empty(&group->list_active))
+			iv_list_add_tail(&group->list_active, groups);
+		iv_list_add_tail(&fd->list_active, &group->ready);
+		fd->group_ready = 1;
+		return;
+	}
+
+	iv_fd_queue_speculative(st, fd);
+
+	if (fd->handler != NULL) {
+		fd->handler(fd->cookie, bands);
+		return;
+	}
+
+	st->handled_fd = fd;
+
+	if (bands & MASKERR)
+		if (fd->handler_err != NULL)
+			fd->handler_err(fd->cookie);
+
+	if (st->handled_fd != NULL && bands & MASKIN)
+		if (fd->handler_in != NULL)
+			fd->handler_in(fd->cookie);
+
+	if (st->handled_fd != NULL && bands & MASKOUT)
+		if (fd->handler_out != NULL)
+			fd->handler_out(fd->cookie);
+}
+
+int iv_fd_poll_and_run(struct iv_state *st, struct timespec *to)
 {
 	struct iv_list_head active;
+	struct iv_list_head high;
+	struct iv_list_head groups;
+	struct iv_list_head *ilh;
+	struct iv_list_head *ilh2;
+	int events;
+	int budget;
+
+	/*
+	 * If there are ready fds left over from the previous round
+	 * because we ran out of dispatch budget, don't block.  Fds
+	 * on the deferred list that are reported ready again by the
+	 * poll method will stay on the deferred list.
+	 */
+	if (!iv_list_empty(&st->fds_deferred)) {
+		to->tv_sec = 0;
+		to->tv_nsec = 0;
+	}
 
 	INIT_IV_LIST_HEAD(&active);
 	method->poll(st, &active, to);
 
 	__iv_invalidate_now(st);
 
+	events = !iv_list_empty(&active) || !iv_list_empty(&st->fds_deferred);
+
+	INIT_IV_LIST_HEAD(&high);
+	iv_list_for_each_safe (ilh, ilh2, &active) {
+		struct iv_fd_ *fd;
+
+		fd = iv_list_entry(ilh, struct iv_fd_, list_active);
+		if (fd->priority == IV_FD_PRIORITY_HIGH) {
+			iv_list_del(&fd->list_active);
+			iv_list_add_tail(&fd->list_active, &high);
+		}
+	}
+
+	iv_list_splice_init(&st->fds_deferred, &active);
+
+	INIT_IV_LIST_HEAD(&groups);
+
+	while (!iv_list_empty(&high)) {
+		struct iv_fd_ *fd;
+
+		fd = iv_list_entry(high.next, struct iv_fd_, list_active);
+		iv_list_del_init(&fd->list_active);
+
+		iv_fd_dispatch(st, &groups, fd);
+	}
+
+	/*
+	 * The dispatch budget only applies to normal priority fds.
+	 * Whatever doesn't fit in the budget is carried over to the
+	 * next round, ahead of fds that become ready in that round.
+	 */
+	budget = st->fd_budget;
 	while (!iv_list_empty(&active)) {
 		struct iv_fd_ *fd;
 
+		if (st->fd_budget && !budget--)
+			break;
+
 		fd = iv_list_entry(active.next, struct iv_fd_, list_active);
 		iv_list_del_init(&fd->list_active);
 
-		st->handled_fd = fd;
+		iv_fd_dispatch(st, &groups, fd);
+	}
+
+	iv_list_splice_tail_init(&active, &st->fds_deferred);
+
+	iv_fd_run_groups(st, &groups);
+
+	return events;
+}
+
+int iv_fd_pending(struct iv_state *st)
+{
+	return !iv_list_empty(&st->fds_deferred);
+}
+
+int iv_fd_pollable_fd(struct iv_state *st)
+{
+	if (method->pollable_fd == NULL)
+		return -1;
+
+	return method->pollable_fd(st);
+}
+
+static void iv_fd_run_speculative(void *_st)
+{
+	struct iv_state *st = _st;
+	struct iv_list_head active;
+	struct iv_list_head groups;
 
-		if (fd->ready_bands & MASKERR)
-			if (fd->handler_err != NULL)
-				fd->handler_err(fd->cookie);
+	INIT_IV_LIST_HEAD(&active);
+	iv_list_splice_init(&st->fds_speculative, &active);
 
-		if (st->handled_fd != NULL && fd->ready_bands & MASKIN)
-			if (fd->handler_in != NULL)
-				fd->handler_in(fd->cookie);
+	INIT_IV_LIST_HEAD(&groups);
+
+	while (!iv_list_empty(&active)) {
+		struct iv_fd_ *fd;
+
+		fd = iv_list_entry(active.next, struct iv_fd_, list_active);
+		iv_list_del_init(&fd->list_active);
 
-		if (st->handled_fd != NULL && fd->ready_bands & MASKOUT)
-			if (fd->handler_out != NULL)
-				fd->handler_out(fd->cookie);
+		iv_fd_dispatch(st, &groups, fd);
 	}
+
+	iv_fd_run_groups(st, &groups);
 }
 
 void iv_fd_make_ready(struct iv_list_head *active, struct iv_fd_ *fd, int bands)
@@ -203,7 +500,12 @@ void iv_fd_set_nonblock(int fd)
 /* public use ***************************************************************/
 const char *iv_poll_method_name(void)
 {
-	return method != NULL ? method->name : NULL;
+	return maxfd ? method->name : NULL;
+}
+
+int iv_loop_fd(struct iv_loop *loop)
+{
+	return iv_fd_pollable_fd(iv_loop_to_state(loop));
 }
 
 void IV_FD_INIT(struct iv_fd *_fd)
@@ -214,7 +516,33 @@ void IV_FD_INIT(struct iv_fd *_fd)
 	fd->handler_in = NULL;
 	fd->handler_out = NULL;
 	fd->handler_err = NULL;
+	fd->handler = NULL;
+	fd->priority = IV_FD_PRIORITY_NORMAL;
 	fd->registered = 0;
+	fd->group = NULL;
+	fd->speculative = 0;
+	fd->speculative_bands = 0;
+	fd->handler_bands = 0;
+	fd->oneshot = 0;
+	fd->exclusive = 0;
+}
+
+static int iv_fd_handler_bands(struct iv_fd_ *fd)
+{
+	int bands;
+
+	if (fd->handler != NULL)
+		return fd->handler_bands;
+
+	bands = 0;
+	if (fd->handler_in != NULL)
+		bands |= MASKIN;
+	if (fd->handler_out != NULL)
+		bands |= MASKOUT;
+	if (fd->handler_err != NULL)
+		bands |= MASKERR;
+
+	return bands;
 }
 
 static void recompute_wanted_flags(struct iv_fd_ *fd)
@@ -222,14 +550,8 @@ static void recompute_wanted_flags(struct iv_fd_ *fd)
 	int wanted;
 
 	wanted = 0;
-	if (fd->registered) {
-		if (fd->handler_in != NULL)
-			wanted |= MASKIN;
-		if (fd->handler_out != NULL)
-			wanted |= MASKOUT;
-		if (fd->handler_err != NULL)
-			wanted |= MASKERR;
-	}
+	if (fd->registered && !fd->disarmed)
+		wanted = iv_fd_handler_bands(fd) & ~fd->speculative_bands;
 
 	fd->wanted_bands = wanted;
 }
@@ -241,6 +563,27 @@ static void notify_fd(struct iv_state *st, struct iv_fd_ *fd)
 	method->notify_fd(st, fd);
 }
 
+/*
+ * Called after an fd's handlers were changed.  Input and output
+ * bands that were enabled by the change are presumed ready if the
+ * fd is speculative.
+ */
+static void
+update_handlers(struct iv_state *st, struct iv_fd_ *fd, int old_bands)
+{
+	int bands;
+
+	bands = iv_fd_handler_bands(fd);
+
+	fd->speculative_bands &= bands;
+	if (fd->speculative)
+		fd->speculative_bands |= bands & ~old_bands & (MASKIN | MASKOUT);
+
+	notify_fd(st, fd);
+
+	iv_fd_queue_speculative(st, fd);
+}
+
 static void iv_fd_register_prologue(struct iv_state *st, struct iv_fd_ *fd)
 {
 	if (fd->registered) {
@@ -248,6 +591,12 @@ static void iv_fd_register_prologue(struct iv_state *st, struct iv_fd_ *fd)
 			 "still registered");
 	}
 
+	/*
+	 * RLIMIT_NOFILE may have been raised since we last looked.
+	 */
+	if (fd->fd >= maxfd)
+		update_maxfd();
+
 	if (fd->fd < 0 || fd->fd >= maxfd) {
 		iv_fatal("iv_fd_register: called with invalid fd %d "
 			 "(maxfd=%d)", fd->fd, maxfd);
@@ -257,6 +606,10 @@ static void iv_fd_register_prologue(struct iv_state *st, struct iv_fd_ *fd)
 	INIT_IV_LIST_HEAD(&fd->list_active);
 	fd->ready_bands = 0;
 	fd->registered_bands = 0;
+	fd->speculative_bands = 0;
+	fd->disarmed = 0;
+	fd->parked = 0;
+	fd->group_ready = 0;
 #if defined(HAVE_SYS_DEVPOLL_H) || defined(HAVE_EPOLL_CREATE) ||	\
     defined(HAVE_KQUEUE) || defined(HAVE_PORT_CREATE)
 	INIT_IV_LIST_HEAD(&fd->list_notify);
@@ -280,16 +633,28 @@ static void iv_fd_register_epilogue(struct iv_state *st, struct iv_fd_ *fd)
 	setsockopt(fd->fd, SOL_SOCKET, SO_OOBINLINE, &yes, sizeof(yes));
 }
 
-void iv_fd_register(struct iv_fd *_fd)
+void iv_loop_fd_register(struct iv_loop *loop, struct iv_fd *_fd)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
 
 	iv_fd_register_prologue(st, fd);
 
+	if (fd->speculative) {
+		fd->speculative_bands = iv_fd_handler_bands(fd) &
+					(MASKIN | MASKOUT);
+	}
+
 	notify_fd(st, fd);
 
 	iv_fd_register_epilogue(st, fd);
+
+	iv_fd_queue_speculative(st, fd);
+}
+
+void iv_fd_register(struct iv_fd *fd)
+{
+	iv_loop_fd_register(iv_get_loop(), fd);
 }
 
 int iv_fd_register_try(struct iv_fd *_fd)
@@ -325,9 +690,9 @@ int iv_fd_register_try(struct iv_fd *_fd)
 	return 0;
 }
 
-void iv_fd_unregister(struct iv_fd *_fd)
+void iv_loop_fd_unregister(struct iv_loop *loop, struct iv_fd *_fd)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
 
 	if (!fd->registered) {
@@ -349,6 +714,11 @@ void iv_fd_unregister(struct iv_fd *_fd)
 		st->handled_fd = NULL;
 }
 
+void iv_fd_unregister(struct iv_fd *fd)
+{
+	iv_loop_fd_unregister(iv_get_loop(), fd);
+}
+
 int iv_fd_registered(struct iv_fd *_fd)
 {
 	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
@@ -356,44 +726,266 @@ int iv_fd_registered(struct iv_fd *_fd)
 	return fd->registered;
 }
 
-void iv_fd_set_handler_in(struct iv_fd *_fd, void (*handler_in)(void *))
+void iv_loop_fd_set_handler_in(struct iv_loop *loop, struct iv_fd *_fd,
+			       void (*handler_in)(void *))
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+	int old;
 
 	if (!fd->registered) {
 		iv_fatal("iv_fd_set_handler_in: called with fd which "
 			 "is not registered");
 	}
 
+	old = iv_fd_handler_bands(fd);
 	fd->handler_in = handler_in;
-	notify_fd(st, fd);
+	update_handlers(st, fd, old);
 }
 
-void iv_fd_set_handler_out(struct iv_fd *_fd, void (*handler_out)(void *))
+void iv_fd_set_handler_in(struct iv_fd *fd, void (*handler_in)(void *))
 {
-	struct iv_state *st = iv_get_state();
+	iv_loop_fd_set_handler_in(iv_get_loop(), fd, handler_in);
+}
+
+void iv_loop_fd_set_handler_out(struct iv_loop *loop, struct iv_fd *_fd,
+				void (*handler_out)(void *))
+{
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+	int old;
 
 	if (!fd->registered) {
 		iv_fatal("iv_fd_set_handler_out: called with fd which "
 			 "is not registered");
 	}
 
+	old = iv_fd_handler_bands(fd);
 	fd->handler_out = handler_out;
-	notify_fd(st, fd);
+	update_handlers(st, fd, old);
 }
 
-void iv_fd_set_handler_err(struct iv_fd *_fd, void (*handler_err)(void *))
+void iv_fd_set_handler_out(struct iv_fd *fd, void (*handler_out)(void *))
 {
-	struct iv_state *st = iv_get_state();
+	iv_loop_fd_set_handler_out(iv_get_loop(), fd, handler_out);
+}
+
+void iv_loop_fd_set_handler_err(struct iv_loop *loop, struct iv_fd *_fd,
+				void (*handler_err)(void *))
+{
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+	int old;
 
 	if (!fd->registered) {
 		iv_fatal("iv_fd_set_handler_err: called with fd which "
 			 "is not registered");
 	}
 
+	old = iv_fd_handler_bands(fd);
 	fd->handler_err = handler_err;
-	notify_fd(st, fd);
+	update_handlers(st, fd, old);
+}
+
+void iv_fd_set_handler_err(struct iv_fd *fd, void (*handler_err)(void *))
+{
+	iv_loop_fd_set_handler_err(iv_get_loop(), fd, handler_err);
+}
+
+void iv_loop_fd_set_handler(struct iv_loop *loop, struct iv_fd *_fd,
+			    void (*handler)(void *, int), int bands)
+{
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+	int old;
+
+	if (fd->exclusive && handler != NULL && bands & (MASKRDHUP | MASKPRI)) {
+		iv_fatal("iv_fd_set_handler: can't watch for RDHUP or PRI "
+			 "on an exclusive fd");
+	}
+
+	old = iv_fd_handler_bands(fd);
+
+	fd->handler = handler;
+	fd->handler_bands = bands & MASKALL;
+
+	if (fd->registered)
+		update_handlers(iv_loop_to_state(loop), fd, old);
+}
+
+void iv_fd_set_handler(struct iv_fd *fd,
+		       void (*handler)(void *, int), int bands)
+{
+	iv_loop_fd_set_handler(iv_get_loop(), fd, handler, bands);
+}
+
+void IV_FD_GROUP_INIT(struct iv_fd_group *_group)
+{
+	struct iv_fd_group_ *group = (struct iv_fd_group_ *)_group;
+
+	INIT_IV_LIST_HEAD(&group->ready);
+	INIT_IV_LIST_HEAD(&group->list_active);
+}
+
+void iv_loop_fd_set_group(struct iv_loop *loop, struct iv_fd *_fd,
+			  struct iv_fd_group *_group)
+{
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+	struct iv_fd_group_ *group = (struct iv_fd_group_ *)_group;
+
+	/*
+	 * If the fd is waiting on its current group's ready list,
+	 * it would otherwise be reported to a group it is no longer
+	 * a member of.  Carry its pending event over to the next
+	 * loop iteration instead, where it will be dispatched to the
+	 * new group, or to the fd's own handlers, in the usual way.
+	 * A oneshot fd was disarmed when it was put on the group's
+	 * ready list, so undo that, as it will be disarmed again
+	 * when it is dispatched.  Fds that are on any other list
+	 * haven't been dispatched yet, and can stay where they are.
+	 */
+	if (fd->registered && fd->group_ready) {
+		struct iv_state *st = iv_loop_to_state(loop);
+
+		iv_list_del_init(&fd->list_active);
+		fd->group_ready = 0;
+		fd->disarmed = 0;
+		iv_list_add_tail(&fd->list_active, &st->fds_deferred);
+	}
+
+	fd->group = group;
+}
+
+void iv_fd_set_group(struct iv_fd *fd, struct iv_fd_group *group)
+{
+	iv_loop_fd_set_group(iv_get_loop(), fd, group);
+}
+
+void iv_fd_set_limit(int limit)
+{
+	fd_limit = (limit > 0) ? limit : 0;
+
+	/*
+	 * If ivykis has already been initialised, apply the new limit
+	 * right away.
+	 */
+	if (maxfd)
+		sanitise_nofile_rlimit(geteuid());
+}
+
+void iv_loop_fd_set_budget(struct iv_loop *loop, int budget)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+
+	st->fd_budget = budget;
+}
+
+void iv_fd_set_budget(int budget)
+{
+	iv_loop_fd_set_budget(iv_get_loop(), budget);
+}
+
+void iv_loop_fd_set_speculative(struct iv_loop *loop, struct iv_fd *_fd,
+				int speculative)
+{
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+
+	fd->speculative = !!speculative;
+
+	/*
+	 * If speculation is being turned off, hand the bands that
+	 * are currently presumed ready over to the kernel.
+	 */
+	if (fd->registered && !speculative && fd->speculative_bands) {
+		fd->speculative_bands = 0;
+		notify_fd(iv_loop_to_state(loop), fd);
+	}
+}
+
+void iv_fd_set_speculative(struct iv_fd *fd, int speculative)
+{
+	iv_loop_fd_set_speculative(iv_get_loop(), fd, speculative);
+}
+
+void iv_loop_fd_would_block(struct iv_loop *loop, struct iv_fd *_fd,
+			    int bands)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+
+	if (!fd->registered) {
+		iv_fatal("iv_fd_would_block: called with fd which "
+			 "is not registered");
+	}
+
+	bands &= fd->speculative_bands;
+	if (bands) {
+		fd->speculative_bands &= ~bands;
+		fd->ready_bands &= ~bands;
+		if (!fd->ready_bands) {
+			iv_list_del_init(&fd->list_active);
+			fd->group_ready = 0;
+		}
+		notify_fd(st, fd);
+	}
+}
+
+void iv_fd_would_block(struct iv_fd *fd, int bands)
+{
+	iv_loop_fd_would_block(iv_get_loop(), fd, bands);
+}
+
+void iv_fd_set_oneshot(struct iv_fd *_fd, int oneshot)
+{
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+
+	if (fd->registered) {
+		iv_fatal("iv_fd_set_oneshot: called with fd which "
+			 "is still registered");
+	}
+
+	fd->oneshot = !!oneshot;
+}
+
+void iv_loop_fd_rearm(struct iv_loop *loop, struct iv_fd *_fd)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+
+	if (!fd->registered) {
+		iv_fatal("iv_fd_rearm: called with fd which "
+			 "is not registered");
+	}
+
+	if (fd->disarmed) {
+		fd->disarmed = 0;
+		notify_fd(st, fd);
+		iv_fd_queue_speculative(st, fd);
+	}
+}
+
+void iv_fd_rearm(struct iv_fd *fd)
+{
+	iv_loop_fd_rearm(iv_get_loop(), fd);
+}
+
+void iv_fd_set_exclusive(struct iv_fd *_fd, int exclusive)
+{
+	struct iv_fd_ *fd = (struct iv_fd_ *)_fd;
+
+	if (fd->registered) {
+		iv_fatal("iv_fd_set_exclusive: called with fd which "
+			 "is still registered");
+	}
+
+	/*
+	 * EPOLLEXCLUSIVE can't be combined with EPOLLRDHUP or
+	 * EPOLLPRI, so refuse this combination everywhere rather
+	 * than only failing at registration time under epoll.
+	 */
+	if (exclusive && iv_fd_handler_bands(fd) & (MASKRDHUP | MASKPRI)) {
+		iv_fatal("iv_fd_set_exclusive: can't make an fd that "
+			 "watches for RDHUP or PRI exclusive");
+	}
+
+	fd->exclusive = !!exclusive;
 }
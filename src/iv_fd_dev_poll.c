@@ -93,6 +93,8 @@ static int bits_to_poll_mask(int bits)
 		mask |= POLLIN;
 	if (bits & MASKOUT)
 		mask |= POLLOUT;
+	if (bits & MASKPRI)
+		mask |= POLLPRI;
 
 	return mask;
 }
@@ -164,7 +166,7 @@ static void
 iv_fd_dev_poll_poll(struct iv_state *st,
 		    struct iv_list_head *active, struct timespec *to)
 {
-	struct pollfd batch[st->numfds ? : 1];
+	struct pollfd batch[iv_fd_poll_batch_size(st)];
 	struct dvpoll dvp;
 	int ret;
 	int i;
@@ -172,7 +174,7 @@ iv_fd_dev_poll_poll(struct iv_state *st,
 	iv_fd_dev_poll_flush_pending(st);
 
 	dvp.dp_fds = batch;
-	dvp.dp_nfds = st->numfds ? : 1;
+	dvp.dp_nfds = sizeof(batch) / sizeof(batch[0]);
 	dvp.dp_timeout = 1000 * to->tv_sec + ((to->tv_nsec + 999999) / 1000000);
 
 	ret = ioctl(st->u.dev_poll.poll_fd, DP_POLL, &dvp);
@@ -204,6 +206,12 @@ iv_fd_dev_poll_poll(struct iv_state *st,
 
 		if (revents & (POLLERR | POLLHUP))
 			iv_fd_make_ready(active, fd, MASKERR);
+
+		if (revents & POLLHUP)
+			iv_fd_make_ready(active, fd, MASKRDHUP);
+
+		if (revents & POLLPRI)
+			iv_fd_make_ready(active, fd, MASKPRI);
 	}
 }
 
@@ -259,7 +267,7 @@ static void iv_fd_dev_poll_deinit(struct iv_state *st)
 }
 
 
-struct iv_fd_poll_method iv_fd_poll_method_dev_poll = {
+IV_FD_POLL_METHOD iv_fd_poll_method_dev_poll = {
 	.name		= "dev_poll",
 	.init		= iv_fd_dev_poll_init,
 	.poll		= iv_fd_dev_poll_poll,
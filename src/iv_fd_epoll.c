@@ -26,6 +26,10 @@
 #include "iv_private.h"
 #include "iv_fd_private.h"
 
+#ifndef EPOLLRDHUP
+#define EPOLLRDHUP	0
+#endif
+
 static int iv_fd_epoll_init(struct iv_state *st)
 {
 	int fd;
@@ -62,10 +66,39 @@ static int bits_to_poll_mask(int bits)
 		mask |= EPOLLIN;
 	if (bits & MASKOUT)
 		mask |= EPOLLOUT;
+	if (bits & MASKRDHUP)
+		mask |= EPOLLRDHUP;
+	if (bits & MASKPRI)
+		mask |= EPOLLPRI;
 
 	return mask;
 }
 
+/*
+ * EPOLLONESHOT can't be combined with EPOLLEXCLUSIVE, so exclusive
+ * oneshot fds are disarmed by dropping interest in them instead.
+ */
+static int kernel_oneshot(struct iv_fd_ *fd)
+{
+#ifdef EPOLLEXCLUSIVE
+	return fd->oneshot && !fd->exclusive;
+#else
+	return fd->oneshot;
+#endif
+}
+
+static int epoll_ctl_retry(struct iv_state *st, int op, struct iv_fd_ *fd,
+			   struct epoll_event *event)
+{
+	int ret;
+
+	do {
+		ret = epoll_ctl(st->u.epoll.epoll_fd, op, fd->fd, event);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
 static int __iv_fd_epoll_flush_one(struct iv_state *st, struct iv_fd_ *fd)
 {
 	int op;
@@ -74,24 +107,58 @@ static int __iv_fd_epoll_flush_one(struct iv_state *st, struct iv_fd_ *fd)
 
 	iv_list_del_init(&fd->list_notify);
 
-	if (fd->registered_bands == fd->wanted_bands)
-		return 0;
-
-	if (!fd->registered_bands && fd->wanted_bands)
-		op = EPOLL_CTL_ADD;
-	else if (fd->registered_bands && !fd->wanted_bands)
-		op = EPOLL_CTL_DEL;
-	else
-		op = EPOLL_CTL_MOD;
+	/*
+	 * Oneshot fds are registered with EPOLLONESHOT, and are
+	 * parked, i.e. left in the epoll set with no events armed,
+	 * by the kernel when an event is delivered for them, so
+	 * that disarming them is free.
+	 */
+	if (fd->parked) {
+		if (fd->wanted_bands)
+			op = EPOLL_CTL_MOD;
+		else if (!fd->registered)
+			op = EPOLL_CTL_DEL;
+		else
+			return 0;
+	} else {
+		if (fd->registered_bands == fd->wanted_bands)
+			return 0;
+
+		if (!fd->registered_bands && fd->wanted_bands)
+			op = EPOLL_CTL_ADD;
+		else if (fd->registered_bands && !fd->wanted_bands)
+			op = EPOLL_CTL_DEL;
+		else
+			op = EPOLL_CTL_MOD;
+	}
 
 	event.data.ptr = fd;
 	event.events = bits_to_poll_mask(fd->wanted_bands);
-	do {
-		ret = epoll_ctl(st->u.epoll.epoll_fd, op, fd->fd, &event);
-	} while (ret < 0 && errno == EINTR);
+	if (kernel_oneshot(fd))
+		event.events |= EPOLLONESHOT;
+
+#ifdef EPOLLEXCLUSIVE
+	/*
+	 * Exclusive registrations can't be modified, only deleted
+	 * and added again.
+	 */
+	if (fd->exclusive) {
+		if (op == EPOLL_CTL_MOD) {
+			ret = epoll_ctl_retry(st, EPOLL_CTL_DEL, fd, &event);
+			if (ret < 0)
+				return ret;
+			op = EPOLL_CTL_ADD;
+		}
+		event.events |= EPOLLEXCLUSIVE;
+	}
+#endif
 
-	if (ret == 0)
+	ret = epoll_ctl_retry(st, op, fd, &event);
+
+	if (ret == 0) {
 		fd->registered_bands = fd->wanted_bands;
+		fd->parked = 0;
+	}
 
 	return ret;
 }
@@ -119,7 +186,7 @@ static void iv_fd_epoll_flush_pending(struct iv_state *st)
 static void iv_fd_epoll_poll(struct iv_state *st,
 			     struct iv_list_head *active, struct timespec *to)
 {
-	struct epoll_event batch[st->numfds ? : 1];
+	struct epoll_event batch[iv_fd_poll_batch_size(st)];
 	int msec;
 	int ret;
 	int i;
@@ -128,7 +195,8 @@ static void iv_fd_epoll_poll(struct iv_state *st,
 
 	msec = 1000 * to->tv_sec + ((to->tv_nsec + 999999) / 1000000);
 
-	ret = epoll_wait(st->u.epoll.epoll_fd, batch, st->numfds ? : 1, msec);
+	ret = epoll_wait(st->u.epoll.epoll_fd, batch,
+			 sizeof(batch) / sizeof(batch[0]), msec);
 	if (ret < 0) {
 		if (errno == EINTR)
 			return;
@@ -144,6 +212,11 @@ static void iv_fd_epoll_poll(struct iv_state *st,
 		fd = batch[i].data.ptr;
 		events = batch[i].events;
 
+		if (kernel_oneshot(fd)) {
+			fd->registered_bands = 0;
+			fd->parked = 1;
+		}
+
 		if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
 			iv_fd_make_ready(active, fd, MASKIN);
 
@@ -152,6 +225,12 @@ static void iv_fd_epoll_poll(struct iv_state *st,
 
 		if (events & (EPOLLERR | EPOLLHUP))
 			iv_fd_make_ready(active, fd, MASKERR);
+
+		if (events & (EPOLLRDHUP | EPOLLHUP))
+			iv_fd_make_ready(active, fd, MASKRDHUP);
+
+		if (events & EPOLLPRI)
+			iv_fd_make_ready(active, fd, MASKPRI);
 	}
 }
 
@@ -164,7 +243,7 @@ static void iv_fd_epoll_unregister_fd(struct iv_state *st, struct iv_fd_ *fd)
 static void iv_fd_epoll_notify_fd(struct iv_state *st, struct iv_fd_ *fd)
 {
 	iv_list_del_init(&fd->list_notify);
-	if (fd->registered_bands != fd->wanted_bands)
+	if (fd->registered_bands != fd->wanted_bands || fd->parked)
 		iv_list_add_tail(&fd->list_notify, &st->u.epoll.notify);
 }
 
@@ -178,8 +257,15 @@ static void iv_fd_epoll_deinit(struct iv_state *st)
 	close(st->u.epoll.epoll_fd);
 }
 
+static int iv_fd_epoll_pollable_fd(struct iv_state *st)
+{
+	iv_fd_epoll_flush_pending(st);
+
+	return st->u.epoll.epoll_fd;
+}
+
 
-struct iv_fd_poll_method iv_fd_poll_method_epoll = {
+IV_FD_POLL_METHOD iv_fd_poll_method_epoll = {
 	.name		= "epoll",
 	.init		= iv_fd_epoll_init,
 	.poll		= iv_fd_epoll_poll,
@@ -187,4 +273,5 @@ struct iv_fd_poll_method iv_fd_poll_method_epoll = {
 	.notify_fd	= iv_fd_epoll_notify_fd,
 	.notify_fd_sync	= iv_fd_epoll_notify_fd_sync,
 	.deinit		= iv_fd_epoll_deinit,
+	.pollable_fd	= iv_fd_epoll_pollable_fd,
 };
@@ -136,7 +136,7 @@ static void iv_fd_kqueue_poll(struct iv_state *st,
 {
 	struct kevent kev[UPLOAD_BATCH];
 	int num;
-	struct kevent batch[st->numfds ? : 1];
+	struct kevent batch[iv_fd_poll_batch_size(st)];
 	int ret;
 	int i;
 
@@ -149,11 +149,11 @@ static void iv_fd_kqueue_poll(struct iv_state *st,
 	 * jump or move depends on uninitialised value(s)".  Zero the
 	 * udata fields here as an ugly workaround.
 	 */
-	for (i = 0; i < (st->numfds ? : 1); i++)
+	for (i = 0; i < sizeof(batch) / sizeof(batch[0]); i++)
 		batch[i].udata = 0;
 
 	ret = kevent(st->u.kqueue.kqueue_fd, kev, num,
-		     batch, st->numfds ? : 1, to);
+		     batch, sizeof(batch) / sizeof(batch[0]), to);
 	if (ret < 0) {
 		if (errno == EINTR)
 			return;
@@ -268,7 +268,14 @@ static void iv_fd_kqueue_event_send(struct iv_state *dest)
 	kevent_retry("iv_fd_kqueue_event_send", dest, &send, 1);
 }
 
-struct iv_fd_poll_method iv_fd_poll_method_kqueue = {
+static int iv_fd_kqueue_pollable_fd(struct iv_state *st)
+{
+	iv_fd_kqueue_upload_all(st);
+
+	return st->u.kqueue.kqueue_fd;
+}
+
+IV_FD_POLL_METHOD iv_fd_poll_method_kqueue = {
 	.name		= "kqueue",
 	.init		= iv_fd_kqueue_init,
 	.poll		= iv_fd_kqueue_poll,
@@ -279,4 +286,5 @@ struct iv_fd_poll_method iv_fd_poll_method_kqueue = {
 	.event_rx_on	= iv_fd_kqueue_event_rx_on,
 	.event_rx_off	= iv_fd_kqueue_event_rx_off,
 	.event_send	= iv_fd_kqueue_event_send,
+	.pollable_fd	= iv_fd_kqueue_pollable_fd,
 };
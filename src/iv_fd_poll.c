@@ -25,23 +25,45 @@
 #include "iv_private.h"
 #include "iv_fd_private.h"
 
+#ifndef POLLRDHUP
+#define POLLRDHUP	0
+#endif
+
 static int iv_fd_poll_init(struct iv_state *st)
 {
-	st->u.poll.pfds = malloc(maxfd * sizeof(struct pollfd));
-	if (st->u.poll.pfds == NULL)
-		return -1;
-
-	st->u.poll.fds = malloc(maxfd * sizeof(struct iv_fd_ *));
-	if (st->u.poll.fds == NULL) {
-		free(st->u.poll.pfds);
-		return -1;
-	}
-
+	st->u.poll.pfds = NULL;
+	st->u.poll.fds = NULL;
 	st->u.poll.num_regd_fds = 0;
+	st->u.poll.size = 0;
 
 	return 0;
 }
 
+/*
+ * The poll arrays are grown as fds are added to them, so that their
+ * size follows the number of fds in use rather than RLIMIT_NOFILE.
+ */
+static void iv_fd_poll_grow(struct iv_state *st)
+{
+	struct pollfd *pfds;
+	struct iv_fd_ **fds;
+	int size;
+
+	size = st->u.poll.size ? 2 * st->u.poll.size : 64;
+
+	pfds = realloc(st->u.poll.pfds, size * sizeof(struct pollfd));
+	if (pfds == NULL)
+		iv_fatal("iv_fd_poll_grow: out of memory");
+	st->u.poll.pfds = pfds;
+
+	fds = realloc(st->u.poll.fds, size * sizeof(struct iv_fd_ *));
+	if (fds == NULL)
+		iv_fatal("iv_fd_poll_grow: out of memory");
+	st->u.poll.fds = fds;
+
+	st->u.poll.size = size;
+}
+
 static void iv_fd_poll_poll(struct iv_state *st,
 			    struct iv_list_head *active, struct timespec *to)
 {
@@ -81,6 +103,12 @@ static void iv_fd_poll_poll(struct iv_state *st,
 
 		if (revents & (POLLERR | POLLHUP))
 			iv_fd_make_ready(active, fd, MASKERR);
+
+		if (revents & (POLLRDHUP | POLLHUP))
+			iv_fd_make_ready(active, fd, MASKRDHUP);
+
+		if (revents & POLLPRI)
+			iv_fd_make_ready(active, fd, MASKPRI);
 	}
 }
 
@@ -100,6 +128,10 @@ static int bits_to_poll_mask(int bits)
 		mask |= POLLOUT | POLLHUP;
 	if (bits & MASKERR)
 		mask |= POLLHUP;
+	if (bits & MASKRDHUP)
+		mask |= POLLRDHUP | POLLHUP;
+	if (bits & MASKPRI)
+		mask |= POLLPRI;
 
 	return mask;
 }
@@ -110,6 +142,9 @@ static void iv_fd_poll_notify_fd(struct iv_state *st, struct iv_fd_ *fd)
 		return;
 
 	if (fd->u.index == -1 && fd->wanted_bands) {
+		if (st->u.poll.num_regd_fds == st->u.poll.size)
+			iv_fd_poll_grow(st);
+
 		fd->u.index = st->u.poll.num_regd_fds++;
 		st->u.poll.pfds[fd->u.index].fd = fd->fd;
 		st->u.poll.pfds[fd->u.index].events =
@@ -164,7 +199,7 @@ static void iv_fd_poll_deinit(struct iv_state *st)
 }
 
 
-struct iv_fd_poll_method iv_fd_poll_method_poll = {
+IV_FD_POLL_METHOD iv_fd_poll_method_poll = {
 	.name		= "poll",
 	.init		= iv_fd_poll_init,
 	.poll		= iv_fd_poll_poll,
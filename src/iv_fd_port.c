@@ -53,6 +53,8 @@ static int bits_to_poll_mask(int bits)
 		mask |= POLLIN;
 	if (bits & MASKOUT)
 		mask |= POLLOUT;
+	if (bits & MASKPRI)
+		mask |= POLLPRI;
 
 	return mask;
 }
@@ -146,6 +148,12 @@ poll_more:
 			if (revents & (POLLERR | POLLHUP))
 				iv_fd_make_ready(active, fd, MASKERR);
 
+			if (revents & POLLHUP)
+				iv_fd_make_ready(active, fd, MASKRDHUP);
+
+			if (revents & POLLPRI)
+				iv_fd_make_ready(active, fd, MASKPRI);
+
 			fd->registered_bands = 0;
 
 			iv_list_del_init(&fd->list_notify);
@@ -212,7 +220,7 @@ static void iv_fd_port_event_send(struct iv_state *dest)
 	}
 }
 
-struct iv_fd_poll_method iv_fd_poll_method_port = {
+IV_FD_POLL_METHOD iv_fd_poll_method_port = {
 	.name		= "port",
 	.init		= iv_fd_port_init,
 	.poll		= iv_fd_port_poll,
@@ -18,9 +18,33 @@
  * Boston, MA 02110-1301, USA.
  */
 
-#define MASKIN		1
-#define MASKOUT		2
-#define MASKERR		4
+#ifndef __IV_FD_PRIVATE_H
+#define __IV_FD_PRIVATE_H
+
+#define MASKIN		IV_FD_BAND_IN
+#define MASKOUT		IV_FD_BAND_OUT
+#define MASKERR		IV_FD_BAND_ERR
+#define MASKRDHUP	IV_FD_BAND_RDHUP
+#define MASKPRI		IV_FD_BAND_PRI
+#define MASKALL		(MASKIN | MASKOUT | MASKERR | MASKRDHUP | MASKPRI)
+
+struct iv_fd_group_ {
+	/*
+	 * User data.
+	 */
+	void			*cookie;
+	void			(*handler)(void *cookie,
+					   struct iv_fd_ready *ready, int num);
+
+	/*
+	 * Member fds that became ready during this polling round
+	 * are moved from iv_fd_poll_and_run()'s active list onto
+	 * ->ready, and groups that have ready member fds are kept
+	 * on a list of ready groups via ->list_active.
+	 */
+	struct iv_list_head	ready;
+	struct iv_list_head	list_active;
+};
 
 struct iv_fd_ {
 	/*
@@ -31,15 +55,17 @@ struct iv_fd_ {
 	void			(*handler_in)(void *);
 	void			(*handler_out)(void *);
 	void			(*handler_err)(void *);
+	void			(*handler)(void *, int);
+	int			priority;
 
 	/*
-	 * If this fd gathered any events during this polling round,
-	 * fd->list_active will be on iv_main()'s active list, and
-	 * fd->ready_bands will indicate which bands are currently
-	 * active.
+	 * The bitfields below are kept together right after the
+	 * user data, where they fill what would otherwise be
+	 * alignment padding, so that this structure keeps fitting
+	 * inside struct iv_fd.  ->ready_bands is described along
+	 * with ->list_active below.
 	 */
-	struct iv_list_head	list_active;
-	unsigned		ready_bands:3;
+	unsigned		ready_bands:5;
 
 	/*
 	 * Reflects whether the fd has been registered with
@@ -52,7 +78,7 @@ struct iv_fd_ {
 	 * ->wanted_bands is set by the ivykis core to indicate
 	 * which bands currenty have handlers registered for them.
 	 */
-	unsigned		wanted_bands:3;
+	unsigned		wanted_bands:5;
 
 	/*
 	 * ->registered_bands is maintained by the poll method to
@@ -60,7 +86,64 @@ struct iv_fd_ {
 	 * kernel, so that the ivykis core knows when to call
 	 * the poll method's ->notify_fd() on an fd.
 	 */
-	unsigned		registered_bands:3;
+	unsigned		registered_bands:5;
+
+	/*
+	 * If ->speculative is set, bands whose handlers are enabled
+	 * are assumed to be ready, and are kept out of ->wanted_bands
+	 * and thus out of the kernel, until the application reports
+	 * via iv_fd_would_block() that they are not.  The bands for
+	 * which that is currently the case are in ->speculative_bands.
+	 */
+	unsigned		speculative:1;
+	unsigned		speculative_bands:3;
+
+	/*
+	 * ->handler_bands holds the bands that the combined
+	 * ->handler was enabled for by iv_fd_set_handler().
+	 */
+	unsigned		handler_bands:5;
+
+	/*
+	 * A ->oneshot fd is disarmed, by setting ->disarmed, each
+	 * time it is dispatched, which takes it out of the kernel's
+	 * interest set, and it stays that way until it is re-armed
+	 * by iv_fd_rearm().  Poll methods that support disarming in
+	 * the kernel upon event delivery use ->parked to remember
+	 * that the kernel has done so.
+	 */
+	unsigned		oneshot:1;
+	unsigned		disarmed:1;
+	unsigned		parked:1;
+
+	/*
+	 * ->exclusive asks the poll method to wake up only one of
+	 * the threads that have the underlying file descriptor
+	 * registered when it becomes ready, where supported.
+	 */
+	unsigned		exclusive:1;
+
+	/*
+	 * ->group_ready is set while the fd is waiting on its
+	 * group's ready list, as opposed to any of the other lists
+	 * that ->list_active can be on.
+	 */
+	unsigned		group_ready:1;
+
+	/*
+	 * If this fd gathered any events during this polling round,
+	 * fd->list_active will be on iv_main()'s active list, and
+	 * fd->ready_bands will indicate which bands are currently
+	 * active.
+	 */
+	struct iv_list_head	list_active;
+
+	/*
+	 * If this fd is a member of an fd group, readiness events
+	 * for this fd are delivered to the group's handler instead
+	 * of to the fd's own handlers.
+	 */
+	struct iv_fd_group_	*group;
 
 #if defined(HAVE_SYS_DEVPOLL_H) || defined(HAVE_EPOLL_CREATE) ||	\
     defined(HAVE_KQUEUE) || defined(HAVE_PORT_CREATE)
@@ -98,16 +181,44 @@ struct iv_fd_poll_method {
 	int	(*event_rx_on)(struct iv_state *st);
 	void	(*event_rx_off)(struct iv_state *st);
 	void	(*event_send)(struct iv_state *dest);
+	int	(*pollable_fd)(struct iv_state *st);
 };
 
 extern int maxfd;
-extern struct iv_fd_poll_method *method;
+extern const struct iv_fd_poll_method *method;
 
-extern struct iv_fd_poll_method iv_fd_poll_method_dev_poll;
-extern struct iv_fd_poll_method iv_fd_poll_method_epoll;
-extern struct iv_fd_poll_method iv_fd_poll_method_kqueue;
-extern struct iv_fd_poll_method iv_fd_poll_method_poll;
-extern struct iv_fd_poll_method iv_fd_poll_method_port;
+/*
+ * Poll methods that receive ready fds into an on-stack array size
+ * it by the number of registered fds, but no larger than this, so
+ * that loops with very many fds don't overflow the stack.  Ready fds
+ * that don't fit are picked up by the next poll.
+ */
+#define MAX_POLL_BATCH		1024
+
+static inline int iv_fd_poll_batch_size(struct iv_state *st)
+{
+	if (st->numfds > MAX_POLL_BATCH)
+		return MAX_POLL_BATCH;
+
+	return st->numfds ? : 1;
+}
+
+/*
+ * If a poll method was selected at configure time, its source file
+ * is included into iv_fd.c, and its method table is made static, so
+ * that the compiler can resolve calls through the table there.
+ */
+#ifdef STATIC_POLL_METHOD
+#define IV_FD_POLL_METHOD	static const struct iv_fd_poll_method
+#else
+#define IV_FD_POLL_METHOD	const struct iv_fd_poll_method
+
+extern IV_FD_POLL_METHOD iv_fd_poll_method_dev_poll;
+extern IV_FD_POLL_METHOD iv_fd_poll_method_epoll;
+extern IV_FD_POLL_METHOD iv_fd_poll_method_kqueue;
+extern IV_FD_POLL_METHOD iv_fd_poll_method_poll;
+extern IV_FD_POLL_METHOD iv_fd_poll_method_port;
+#endif
 
 /* iv_event_posix.c */
 void iv_event_run_pending_events(void);
@@ -117,3 +228,5 @@ void iv_fd_make_ready(struct iv_list_head *active,
 		      struct iv_fd_ *fd, int bands);
 void iv_fd_set_cloexec(int fd);
 void iv_fd_set_nonblock(int fd);
+
+#endif
@@ -77,9 +77,10 @@ void iv_handle_deinit(struct iv_state *st)
 	DeleteCriticalSection(&st->active_handle_list_lock);
 }
 
-void iv_handle_poll_and_run(struct iv_state *st, struct timespec *to)
+int iv_handle_poll_and_run(struct iv_state *st, struct timespec *to)
 {
 	struct iv_list_head handles;
+	int events;
 
 	EnterCriticalSection(&st->active_handle_list_lock);
 	if (iv_list_empty(&st->active_with_handler)) {
@@ -104,6 +105,8 @@ void iv_handle_poll_and_run(struct iv_state *st, struct timespec *to)
 
 	__iv_invalidate_now(st);
 
+	events = !iv_list_empty(&handles);
+
 	while (!iv_list_empty(&handles)) {
 		struct iv_handle_ *h;
 
@@ -117,6 +120,8 @@ void iv_handle_poll_and_run(struct iv_state *st, struct timespec *to)
 			st->handled_handle = INVALID_HANDLE_VALUE;
 		}
 	}
+
+	return events;
 }
 
 void iv_handle_quit(struct iv_state *st)
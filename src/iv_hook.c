@@ -0,0 +1,108 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "iv_private.h"
+
+void iv_hook_init(struct iv_state *st)
+{
+	INIT_IV_LIST_HEAD(&st->hooks[IV_HOOK_PREPARE]);
+	INIT_IV_LIST_HEAD(&st->hooks[IV_HOOK_CHECK]);
+}
+
+/*
+ * Hooks stay registered after they have been run, so move each hook
+ * to a private list before calling its handler, which lets handlers
+ * unregister any hook, including themselves, while we iterate.  Only
+ * the hooks that were registered when we started are run, so that
+ * hooks registered by handlers, including handlers that re-register
+ * themselves, are run in the next round instead of looping forever.
+ */
+void iv_run_hooks(struct iv_state *st, int type)
+{
+	struct iv_list_head *hooks = &st->hooks[type];
+	struct iv_list_head pending;
+	struct iv_list_head done;
+
+	INIT_IV_LIST_HEAD(&pending);
+	iv_list_splice_init(hooks, &pending);
+
+	INIT_IV_LIST_HEAD(&done);
+	while (!iv_list_empty(&pending)) {
+		struct iv_hook_ *h;
+
+		h = iv_list_entry(pending.next, struct iv_hook_, list);
+		iv_list_del(&h->list);
+		iv_list_add_tail(&h->list, &done);
+
+		h->handler(h->cookie);
+	}
+	iv_list_splice(&done, hooks);
+}
+
+void IV_HOOK_INIT(struct iv_hook *_h)
+{
+	struct iv_hook_ *h = (struct iv_hook_ *)_h;
+
+	h->type = IV_HOOK_PREPARE;
+	INIT_IV_LIST_HEAD(&h->list);
+}
+
+void iv_loop_hook_register(struct iv_loop *loop, struct iv_hook *_h)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+	struct iv_hook_ *h = (struct iv_hook_ *)_h;
+
+	if (!iv_list_empty(&h->list))
+		iv_fatal("iv_hook_register: called with hook still on a list");
+
+	if (h->type != IV_HOOK_PREPARE && h->type != IV_HOOK_CHECK)
+		iv_fatal("iv_hook_register: called with invalid type %d",
+			 h->type);
+
+	iv_list_add_tail(&h->list, &st->hooks[h->type]);
+}
+
+void iv_hook_register(struct iv_hook *h)
+{
+	iv_loop_hook_register(iv_get_loop(), h);
+}
+
+void iv_loop_hook_unregister(struct iv_loop *loop, struct iv_hook *_h)
+{
+	struct iv_hook_ *h = (struct iv_hook_ *)_h;
+
+	if (iv_list_empty(&h->list))
+		iv_fatal("iv_hook_unregister: called with hook not on a list");
+
+	iv_list_del_init(&h->list);
+}
+
+void iv_hook_unregister(struct iv_hook *h)
+{
+	iv_loop_hook_unregister(iv_get_loop(), h);
+}
+
+int iv_hook_registered(struct iv_hook *_h)
+{
+	struct iv_hook_ *h = (struct iv_hook_ *)_h;
+
+	return !iv_list_empty(&h->list);
+}
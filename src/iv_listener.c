@@ -0,0 +1,255 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <iv.h>
+#include <iv_listener.h>
+#include "iv_private.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL		0
+#endif
+
+/*
+ * Loop latency is measured as the lateness of a timer that is
+ * scheduled every SAMPLE_INTERVAL msec, averaged over about four
+ * samples.  So as not to keep waking up an idle event loop, we only
+ * sample while saturated and for SAMPLE_LINGER samples after the
+ * last accepted connection.  When running out of fds, accepting is
+ * retried after RETRY_INTERVAL msec.
+ */
+#define SAMPLE_INTERVAL		10
+#define SAMPLE_LINGER		100
+#define RETRY_INTERVAL		100
+
+#define ACCEPT_BATCH		16
+
+static int low_conns(struct iv_listener *this)
+{
+	if (this->low_conns > 0 && this->low_conns < this->max_conns)
+		return this->low_conns;
+
+	return this->max_conns - this->max_conns / 4 - 1;
+}
+
+static int low_latency(struct iv_listener *this)
+{
+	if (this->low_latency > 0 && this->low_latency < this->max_latency)
+		return this->low_latency;
+
+	return this->max_latency / 2;
+}
+
+static void iv_listener_accept(void *_this);
+
+static void arm_sample_timer(struct iv_listener *this)
+{
+	iv_validate_now();
+	this->sample_timer.expires = iv_now;
+	timespec_add_ms(&this->sample_timer.expires, SAMPLE_INTERVAL);
+	iv_timer_register(&this->sample_timer);
+}
+
+/*
+ * While saturated, the listening fd is taken out of the poll set,
+ * so that new connections queue up in the kernel's listen backlog,
+ * unless shedding was asked for, in which case we keep accepting
+ * but close new connections right away.  The same goes for backing
+ * off after running out of fds.
+ */
+static void update_polling(struct iv_listener *this)
+{
+	int poll;
+
+	poll = !this->backoff &&
+	       (!this->saturated || this->shed != IV_LISTENER_SHED_NONE);
+
+	if (poll && this->ivfd.handler_in == NULL)
+		iv_fd_set_handler_in(&this->ivfd, iv_listener_accept);
+	else if (!poll && this->ivfd.handler_in != NULL)
+		iv_fd_set_handler_in(&this->ivfd, NULL);
+}
+
+static void update_saturation(struct iv_listener *this)
+{
+	int conns_high;
+	int conns_low;
+	int latency_high;
+	int latency_low;
+
+	conns_high = this->max_conns && this->conns >= this->max_conns;
+	conns_low = !this->max_conns || this->conns <= low_conns(this);
+
+	latency_high = this->max_latency &&
+		       this->latency > this->max_latency;
+	latency_low = !this->max_latency ||
+		      this->latency <= low_latency(this);
+
+	if (!this->saturated && (conns_high || latency_high))
+		this->saturated = 1;
+	else if (this->saturated && conns_low && latency_low)
+		this->saturated = 0;
+
+	update_polling(this);
+}
+
+static void shed(struct iv_listener *this, int fd)
+{
+	if (this->shed == IV_LISTENER_SHED_REJECT && this->reject_len) {
+		send(fd, this->reject_msg, this->reject_len,
+		     MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+
+	close(fd);
+}
+
+static void iv_listener_accept(void *_this)
+{
+	struct iv_listener *this = _this;
+	int i;
+
+	for (i = 0; i < ACCEPT_BATCH; i++) {
+		int fd;
+
+		fd = accept(this->fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			if (errno == EMFILE || errno == ENFILE ||
+			    errno == ENOBUFS || errno == ENOMEM) {
+				this->backoff = 1;
+				update_polling(this);
+
+				iv_validate_now();
+				this->retry_timer.expires = iv_now;
+				timespec_add_ms(&this->retry_timer.expires,
+						RETRY_INTERVAL);
+				iv_timer_register(&this->retry_timer);
+			}
+
+			break;
+		}
+
+		if (this->max_latency) {
+			this->idle_samples = 0;
+			if (!iv_timer_registered(&this->sample_timer))
+				arm_sample_timer(this);
+		}
+
+		if (this->saturated) {
+			shed(this, fd);
+			continue;
+		}
+
+		this->conns++;
+		update_saturation(this);
+
+		this->handler(this->cookie, fd);
+
+		/*
+		 * The handler may have unregistered the listener, or
+		 * we may have stopped polling it.
+		 */
+		if (!iv_fd_registered(&this->ivfd) ||
+		    this->ivfd.handler_in == NULL)
+			break;
+	}
+}
+
+static void iv_listener_retry(void *_this)
+{
+	struct iv_listener *this = _this;
+
+	this->backoff = 0;
+	update_polling(this);
+}
+
+static void iv_listener_sample(void *_this)
+{
+	struct iv_listener *this = _this;
+	struct timespec now;
+	int late;
+
+	iv_validate_now();
+	now = iv_now;
+
+	late = 1000 * (now.tv_sec - this->sample_timer.expires.tv_sec) +
+	       (now.tv_nsec - this->sample_timer.expires.tv_nsec) / 1000000;
+	if (late < 0)
+		late = 0;
+
+	this->latency = (3 * this->latency + late) / 4;
+	update_saturation(this);
+
+	if (this->saturated || ++this->idle_samples < SAMPLE_LINGER)
+		arm_sample_timer(this);
+}
+
+void iv_listener_register(struct iv_listener *this)
+{
+	IV_FD_INIT(&this->ivfd);
+	this->ivfd.fd = this->fd;
+	this->ivfd.cookie = this;
+	this->ivfd.handler_in = iv_listener_accept;
+	iv_fd_register(&this->ivfd);
+
+	IV_TIMER_INIT(&this->sample_timer);
+	this->sample_timer.cookie = this;
+	this->sample_timer.handler = iv_listener_sample;
+
+	IV_TIMER_INIT(&this->retry_timer);
+	this->retry_timer.cookie = this;
+	this->retry_timer.handler = iv_listener_retry;
+
+	this->conns = 0;
+	this->latency = 0;
+	this->idle_samples = 0;
+	this->saturated = 0;
+	this->backoff = 0;
+}
+
+void iv_listener_unregister(struct iv_listener *this)
+{
+	iv_fd_unregister(&this->ivfd);
+
+	if (iv_timer_registered(&this->sample_timer))
+		iv_timer_unregister(&this->sample_timer);
+
+	if (iv_timer_registered(&this->retry_timer))
+		iv_timer_unregister(&this->retry_timer);
+}
+
+void iv_listener_conn_closed(struct iv_listener *this)
+{
+	if (this->conns > 0)
+		this->conns--;
+
+	if (iv_fd_registered(&this->ivfd))
+		update_saturation(this);
+}
+
+int iv_listener_saturated(struct iv_listener *this)
+{
+	return this->saturated;
+}
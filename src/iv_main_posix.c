@@ -29,20 +29,25 @@ pthread_key_t			iv_state_key;
 __thread struct iv_state	*__st;
 #endif
 
+static void iv_set_state(struct iv_state *st)
+{
+	pthread_setspecific(iv_state_key, st);
+#ifdef HAVE_THREAD
+	__st = st;
+#endif
+}
+
 static void __iv_deinit(struct iv_state *st)
 {
 	iv_fd_deinit(st);
 	iv_timer_deinit(st);
 	iv_tls_thread_deinit(st);
 
-	pthread_setspecific(iv_state_key, NULL);
-#ifdef HAVE_THREAD
-	__st = NULL;
-#endif
+	iv_set_state(NULL);
 
 	barrier();
 
-	free(st);
+	iv_tls_state_free(st);
 }
 
 static void iv_state_destructor(void *data)
@@ -53,7 +58,7 @@ static void iv_state_destructor(void *data)
 	__iv_deinit(st);
 }
 
-void iv_init(void)
+static struct iv_state *__iv_init(void)
 {
 	struct iv_state *st;
 
@@ -63,19 +68,26 @@ void iv_init(void)
 		iv_state_key_allocated = 1;
 	}
 
-	st = calloc(1, iv_tls_total_state_size());
+	st = iv_tls_state_alloc();
+	if (st == NULL)
+		iv_fatal("iv_init: failed to allocate thread state");
 
-	pthread_setspecific(iv_state_key, st);
-#ifdef HAVE_THREAD
-	__st = st;
-#endif
+	iv_set_state(st);
 
 	st->numobjs = 0;
 
 	iv_fd_init(st);
+	iv_hook_init(st);
 	iv_task_init(st);
 	iv_timer_init(st);
 	iv_tls_thread_init(st);
+
+	return st;
+}
+
+void iv_init(void)
+{
+	__iv_init();
 }
 
 int iv_inited(void)
@@ -88,34 +100,65 @@ int iv_inited(void)
 	return iv_get_state() != NULL;
 }
 
-void iv_quit(void)
+void iv_loop_quit(struct iv_loop *loop)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 
 	st->quit = 1;
 }
 
-void iv_main(void)
+void iv_quit(void)
 {
-	struct iv_state *st = iv_get_state();
+	iv_loop_quit(iv_get_loop());
+}
 
-	st->quit = 0;
-	while (1) {
-		struct timespec to;
+static int iv_iterate(struct iv_state *st, struct timespec *timeout)
+{
+	struct timespec to;
+	int busy;
+	int events;
 
-		iv_run_tasks(st);
-		iv_run_timers(st);
+	iv_run_tasks(st);
+	iv_run_timers(st);
 
-		if (st->quit || !st->numobjs)
-			break;
+	if (st->quit || !st->numobjs)
+		return 0;
 
-		if (iv_pending_tasks(st) || iv_get_soonest_timeout(st, &to)) {
-			to.tv_sec = 0;
-			to.tv_nsec = 0;
-		}
+	iv_run_hooks(st, IV_HOOK_PREPARE);
 
-		iv_fd_poll_and_run(st, &to);
+	busy = iv_pending_tasks(st) || iv_get_soonest_timeout(st, &to);
+	if (busy || iv_pending_idle_tasks(st)) {
+		to.tv_sec = 0;
+		to.tv_nsec = 0;
+	} else if (timeout != NULL && timespec_gt(&to, timeout)) {
+		to = *timeout;
 	}
+
+	events = iv_fd_poll_and_run(st, &to);
+
+	iv_run_hooks(st, IV_HOOK_CHECK);
+
+	/*
+	 * Idle tasks only get to run if there was nothing else
+	 * to do in this iteration of the event loop, and the
+	 * poll turned up no new events either.
+	 */
+	if (!events && !busy && !iv_pending_tasks(st))
+		iv_run_idle_tasks(st);
+
+	return 1;
+}
+
+static void __iv_main(struct iv_state *st)
+{
+	st->quit = 0;
+	while (iv_iterate(st, NULL))
+		;
+}
+
+void iv_main(void)
+{
+	__iv_main(iv_get_state());
 }
 
 void iv_deinit(void)
@@ -124,3 +167,87 @@ void iv_deinit(void)
 
 	__iv_deinit(st);
 }
+
+/*
+ * Additional loops are not tied to the calling thread's TLS slot,
+ * but whichever loop is being set up, torn down or run is made the
+ * thread's current loop for the duration, so that callbacks can
+ * keep using the implicit-context API.
+ */
+struct iv_loop *iv_loop_get(void)
+{
+	return iv_inited() ? iv_get_loop() : NULL;
+}
+
+struct iv_loop *iv_loop_create(void)
+{
+	struct iv_loop *prev = iv_loop_get();
+	struct iv_state *st;
+
+	st = __iv_init();
+	iv_set_state(iv_loop_to_state(prev));
+
+	return iv_state_to_loop(st);
+}
+
+void iv_loop_destroy(struct iv_loop *loop)
+{
+	struct iv_loop *prev = iv_loop_get();
+
+	iv_set_state(iv_loop_to_state(loop));
+	__iv_deinit(iv_loop_to_state(loop));
+
+	if (prev != loop)
+		iv_set_state(iv_loop_to_state(prev));
+}
+
+void iv_loop_main(struct iv_loop *loop)
+{
+	struct iv_loop *prev = iv_loop_get();
+
+	iv_set_state(iv_loop_to_state(loop));
+	__iv_main(iv_loop_to_state(loop));
+	iv_set_state(iv_loop_to_state(prev));
+}
+
+int iv_loop_iterate(struct iv_loop *loop, struct timespec *timeout)
+{
+	struct iv_loop *prev = iv_loop_get();
+	struct iv_state *st = iv_loop_to_state(loop);
+	int ret;
+
+	iv_set_state(st);
+
+	st->quit = 0;
+	ret = iv_iterate(st, timeout) && !st->quit && st->numobjs;
+
+	iv_set_state(iv_loop_to_state(prev));
+
+	return ret;
+}
+
+int iv_main_iterate(struct timespec *timeout)
+{
+	return iv_loop_iterate(iv_get_loop(), timeout);
+}
+
+int iv_loop_timeout(struct iv_loop *loop, struct timespec *to)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+
+	/*
+	 * Make sure that the kernel knows about all fd interest
+	 * changes made since the last iteration before the caller
+	 * goes to sleep on iv_loop_fd().
+	 */
+	iv_fd_pollable_fd(st);
+
+	if (iv_pending_tasks(st) || iv_pending_idle_tasks(st) ||
+	    iv_fd_pending(st) || iv_get_soonest_timeout(st, to)) {
+		to->tv_sec = 0;
+		to->tv_nsec = 0;
+		return 1;
+	}
+
+	return !!st->num_timers;
+}
@@ -24,7 +24,12 @@
 
 DWORD iv_state_index = -1;
 
-void iv_init(void)
+static void iv_set_state(struct iv_state *st)
+{
+	TlsSetValue(iv_state_index, st);
+}
+
+static struct iv_state *__iv_init(void)
 {
 	struct iv_state *st;
 
@@ -34,17 +39,27 @@ void iv_init(void)
 			iv_fatal("iv_init: failed to allocate TLS key");
 	}
 
-	st = calloc(1, iv_tls_total_state_size());
-	TlsSetValue(iv_state_index, st);
+	st = iv_tls_state_alloc();
+	if (st == NULL)
+		iv_fatal("iv_init: failed to allocate thread state");
+	iv_set_state(st);
 
 	st->quit = 0;
 	st->numobjs = 0;
 
 	iv_handle_init(st);
+	iv_hook_init(st);
 	iv_task_init(st);
 	iv_time_init(st);
 	iv_timer_init(st);
 	iv_tls_thread_init(st);
+
+	return st;
+}
+
+void iv_init(void)
+{
+	__iv_init();
 }
 
 int iv_inited(void)
@@ -55,9 +70,9 @@ int iv_inited(void)
 	return iv_get_state() != NULL;
 }
 
-void iv_quit(void)
+void iv_loop_quit(struct iv_loop *loop)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 
 	if (!st->quit) {
 		st->quit = 1;
@@ -65,44 +80,79 @@ void iv_quit(void)
 	}
 }
 
-void iv_main(void)
+void iv_quit(void)
 {
-	struct iv_state *st = iv_get_state();
+	iv_loop_quit(iv_get_loop());
+}
 
-	if (st->quit) {
-		st->quit = 0;
-		iv_handle_unquit(st);
+static int iv_iterate(struct iv_state *st, struct timespec *timeout)
+{
+	struct timespec to;
+	int busy;
+	int events;
+
+	iv_run_tasks(st);
+	iv_run_timers(st);
+
+	if (st->quit || !st->numobjs)
+		return 0;
+
+	iv_run_hooks(st, IV_HOOK_PREPARE);
+
+	busy = iv_pending_tasks(st) || iv_get_soonest_timeout(st, &to);
+	if (busy || iv_pending_idle_tasks(st)) {
+		to.tv_sec = 0;
+		to.tv_nsec = 0;
+	} else if (timeout != NULL && timespec_gt(&to, timeout)) {
+		to = *timeout;
 	}
 
-	while (1) {
-		struct timespec to;
+	events = iv_handle_poll_and_run(st, &to);
 
-		iv_run_tasks(st);
-		iv_run_timers(st);
+	iv_run_hooks(st, IV_HOOK_CHECK);
 
-		if (st->quit || !st->numobjs)
-			break;
+	/*
+	 * Idle tasks only get to run if there was nothing else
+	 * to do in this iteration of the event loop, and the
+	 * poll turned up no new events either.
+	 */
+	if (!events && !busy && !iv_pending_tasks(st))
+		iv_run_idle_tasks(st);
 
-		if (iv_pending_tasks(st) || iv_get_soonest_timeout(st, &to)) {
-			to.tv_sec = 0;
-			to.tv_nsec = 0;
-		}
+	return 1;
+}
 
-		iv_handle_poll_and_run(st, &to);
+static void iv_unquit(struct iv_state *st)
+{
+	if (st->quit) {
+		st->quit = 0;
+		iv_handle_unquit(st);
 	}
 }
 
+static void __iv_main(struct iv_state *st)
+{
+	iv_unquit(st);
+	while (iv_iterate(st, NULL))
+		;
+}
+
+void iv_main(void)
+{
+	__iv_main(iv_get_state());
+}
+
 static void __iv_deinit(struct iv_state *st)
 {
 	iv_handle_deinit(st);
 	iv_timer_deinit(st);
 	iv_tls_thread_deinit(st);
 
-	TlsSetValue(iv_state_index, NULL);
+	iv_set_state(NULL);
 
 	barrier();
 
-	free(st);
+	iv_tls_state_free(st);
 }
 
 void iv_deinit(void)
@@ -112,6 +162,83 @@ void iv_deinit(void)
 	__iv_deinit(st);
 }
 
+/*
+ * Additional loops are not tied to the calling thread's TLS slot,
+ * but whichever loop is being set up, torn down or run is made the
+ * thread's current loop for the duration, so that callbacks can
+ * keep using the implicit-context API.
+ */
+struct iv_loop *iv_loop_get(void)
+{
+	return iv_inited() ? iv_get_loop() : NULL;
+}
+
+struct iv_loop *iv_loop_create(void)
+{
+	struct iv_loop *prev = iv_loop_get();
+	struct iv_state *st;
+
+	st = __iv_init();
+	iv_set_state(iv_loop_to_state(prev));
+
+	return iv_state_to_loop(st);
+}
+
+void iv_loop_destroy(struct iv_loop *loop)
+{
+	struct iv_loop *prev = iv_loop_get();
+
+	iv_set_state(iv_loop_to_state(loop));
+	__iv_deinit(iv_loop_to_state(loop));
+
+	if (prev != loop)
+		iv_set_state(iv_loop_to_state(prev));
+}
+
+void iv_loop_main(struct iv_loop *loop)
+{
+	struct iv_loop *prev = iv_loop_get();
+
+	iv_set_state(iv_loop_to_state(loop));
+	__iv_main(iv_loop_to_state(loop));
+	iv_set_state(iv_loop_to_state(prev));
+}
+
+int iv_loop_iterate(struct iv_loop *loop, struct timespec *timeout)
+{
+	struct iv_loop *prev = iv_loop_get();
+	struct iv_state *st = iv_loop_to_state(loop);
+	int ret;
+
+	iv_set_state(st);
+
+	iv_unquit(st);
+	ret = iv_iterate(st, timeout) && !st->quit && st->numobjs;
+
+	iv_set_state(iv_loop_to_state(prev));
+
+	return ret;
+}
+
+int iv_main_iterate(struct timespec *timeout)
+{
+	return iv_loop_iterate(iv_get_loop(), timeout);
+}
+
+int iv_loop_timeout(struct iv_loop *loop, struct timespec *to)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+
+	if (iv_pending_tasks(st) || iv_pending_idle_tasks(st) ||
+	    iv_get_soonest_timeout(st, to)) {
+		to->tv_sec = 0;
+		to->tv_nsec = 0;
+		return 1;
+	}
+
+	return !!st->num_timers;
+}
+
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
 	if (iv_state_index == -1)
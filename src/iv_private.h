@@ -18,6 +18,9 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#ifndef __IV_PRIVATE_H
+#define __IV_PRIVATE_H
+
 #include "iv.h"
 #include "iv_avl.h"
 #include "iv_list.h"
@@ -27,14 +30,32 @@
  * Per-thread state.
  */
 struct iv_state {
+	/*
+	 * The members up to and including ->tasks are accessed by
+	 * the IV_INLINE_FASTPATH inline functions in iv.h through
+	 * struct __iv_loop, and their layout is part of the ABI.
+	 */
+	/* iv_timer.c  */
+	struct timespec		time;
+	int			time_valid;
+
 	/* iv_main_{posix,win32}.c  */
-	int			quit;
 	int			numobjs;
 
+	/* iv_task.c  */
+	struct iv_list_head	tasks[IV_TASK_PRIORITY_HIGH + 1];
+
+	/* iv_main_{posix,win32}.c  */
+	int			quit;
+
 #ifndef _WIN32
 	/* iv_fd.c  */
 	int			numfds;
 	struct iv_fd_		*handled_fd;
+	struct iv_list_head	fds_deferred;
+	int			fd_budget;
+	struct iv_list_head	fds_speculative;
+	struct iv_task		fd_speculative_task;
 #endif
 
 #ifdef _WIN32
@@ -47,12 +68,10 @@ struct iv_state {
 	HANDLE			handled_handle;
 #endif
 
-	/* iv_task.c  */
-	struct iv_list_head	tasks;
+	/* iv_hook.c  */
+	struct iv_list_head	hooks[IV_HOOK_CHECK + 1];
 
 	/* iv_timer.c  */
-	struct timespec		time;
-	int			time_valid;
 	int			num_timers;
 	struct ratnode		*timer_root;
 
@@ -85,6 +104,7 @@ struct iv_state {
 			struct pollfd		*pfds;
 			struct iv_fd_		**fds;
 			int			num_regd_fds;
+			int			size;
 		} poll;
 
 #ifdef HAVE_PORT_CREATE
@@ -122,6 +142,21 @@ static inline struct iv_state *iv_get_state(void)
 }
 #endif
 
+static inline struct iv_state *iv_loop_to_state(struct iv_loop *loop)
+{
+	return (struct iv_state *)loop;
+}
+
+static inline struct iv_loop *iv_state_to_loop(struct iv_state *st)
+{
+	return (struct iv_loop *)st;
+}
+
+static inline struct iv_loop *iv_get_loop(void)
+{
+	return iv_state_to_loop(iv_get_state());
+}
+
 static inline void barrier(void)
 {
 	__asm__ __volatile__("" : : : "memory");
@@ -129,16 +164,31 @@ static inline void barrier(void)
 
 
 /*
- * Private versions of the task/timer structures, exposing their
+ * Private versions of the hook/task/timer structures, exposing their
  * internal state.  The user data fields of these structures MUST
  * match the definitions in the public header file iv.h.
  */
+struct iv_hook_ {
+	/*
+	 * User data.
+	 */
+	void			*cookie;
+	void			(*handler)(void *);
+	int			type;
+
+	/*
+	 * Private data.
+	 */
+	struct iv_list_head	list;
+};
+
 struct iv_task_ {
 	/*
 	 * User data.
 	 */
 	void			*cookie;
 	void			(*handler)(void *);
+	int			priority;
 
 	/*
 	 * Private data.
@@ -164,6 +214,22 @@ struct iv_timer_ {
 /*
  * Misc internal stuff.
  */
+static inline int timespec_gt(struct timespec *a, struct timespec *b)
+{
+	return !!(a->tv_sec > b->tv_sec ||
+		 (a->tv_sec == b->tv_sec && a->tv_nsec > b->tv_nsec));
+}
+
+static inline void timespec_add_ms(struct timespec *ts, int msec)
+{
+	ts->tv_sec += msec / 1000;
+	ts->tv_nsec += 1000000 * (msec % 1000);
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
 static inline void
 __iv_list_steal_elements(struct iv_list_head *oldh, struct iv_list_head *newh)
 {
@@ -184,19 +250,31 @@ __iv_list_steal_elements(struct iv_list_head *oldh, struct iv_list_head *newh)
 /* iv_fd.c */
 void iv_fd_init(struct iv_state *st);
 void iv_fd_deinit(struct iv_state *st);
-void iv_fd_poll_and_run(struct iv_state *st, struct timespec *to);
+int iv_fd_poll_and_run(struct iv_state *st, struct timespec *to);
+int iv_fd_pending(struct iv_state *st);
+int iv_fd_pollable_fd(struct iv_state *st);
 
 /* iv_handle.c */
 void iv_handle_init(struct iv_state *st);
 void iv_handle_deinit(struct iv_state *st);
-void iv_handle_poll_and_run(struct iv_state *st, struct timespec *to);
+int iv_handle_poll_and_run(struct iv_state *st, struct timespec *to);
 void iv_handle_quit(struct iv_state *st);
 void iv_handle_unquit(struct iv_state *st);
 
+/* iv_hook.c */
+void iv_hook_init(struct iv_state *st);
+void iv_run_hooks(struct iv_state *st, int type);
+
 /* iv_task.c */
 void iv_task_init(struct iv_state *st);
 int iv_pending_tasks(struct iv_state *st);
 void iv_run_tasks(struct iv_state *st);
+int iv_pending_idle_tasks(struct iv_state *st);
+void iv_run_idle_tasks(struct iv_state *st);
+
+/* iv_thread_{posix,win32}.c */
+int iv_thread_create_detached(char *name, void (*start_routine)(void *),
+			      void *arg);
 
 /* iv_time_{posix,win32}.c */
 void iv_time_get(struct timespec *time);
@@ -212,6 +290,9 @@ void iv_run_timers(struct iv_state *st);
 void iv_timer_deinit(struct iv_state *st);
 
 /* iv_tls.c */
-int iv_tls_total_state_size(void);
+struct iv_state *iv_tls_state_alloc(void);
+void iv_tls_state_free(struct iv_state *st);
 void iv_tls_thread_init(struct iv_state *st);
 void iv_tls_thread_deinit(struct iv_state *st);
+
+#endif
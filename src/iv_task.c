@@ -22,21 +22,32 @@
 #include <stdlib.h>
 #include "iv_private.h"
 
+/*
+ * Objects compiled with IV_INLINE_FASTPATH reference this, so that
+ * they will refuse to load against a library with a different layout
+ * of the structures that the inline functions in iv.h access.
+ */
+const int __iv_inline_fastpath_abi_1 = 1;
+
 void iv_task_init(struct iv_state *st)
 {
-	INIT_IV_LIST_HEAD(&st->tasks);
+	int i;
+
+	for (i = 0; i <= IV_TASK_PRIORITY_HIGH; i++)
+		INIT_IV_LIST_HEAD(&st->tasks[i]);
 }
 
 int iv_pending_tasks(struct iv_state *st)
 {
-	return !iv_list_empty(&st->tasks);
+	return !iv_list_empty(&st->tasks[IV_TASK_PRIORITY_HIGH]) ||
+	       !iv_list_empty(&st->tasks[IV_TASK_PRIORITY_NORMAL]);
 }
 
-void iv_run_tasks(struct iv_state *st)
+static void iv_run_task_list(struct iv_state *st, struct iv_list_head *list)
 {
 	struct iv_list_head tasks;
 
-	__iv_list_steal_elements(&st->tasks, &tasks);
+	__iv_list_steal_elements(list, &tasks);
 	while (!iv_list_empty(&tasks)) {
 		struct iv_task_ *t;
 
@@ -49,28 +60,62 @@ void iv_run_tasks(struct iv_state *st)
 	}
 }
 
+/*
+ * High-priority tasks are run before normal-priority tasks, and
+ * high-priority tasks that are registered by normal-priority task
+ * handlers are run before control returns to the main loop, so that
+ * they are never delayed by timers or file descriptor events.
+ */
+void iv_run_tasks(struct iv_state *st)
+{
+	iv_run_task_list(st, &st->tasks[IV_TASK_PRIORITY_HIGH]);
+	iv_run_task_list(st, &st->tasks[IV_TASK_PRIORITY_NORMAL]);
+	iv_run_task_list(st, &st->tasks[IV_TASK_PRIORITY_HIGH]);
+}
+
+int iv_pending_idle_tasks(struct iv_state *st)
+{
+	return !iv_list_empty(&st->tasks[IV_TASK_PRIORITY_IDLE]);
+}
+
+void iv_run_idle_tasks(struct iv_state *st)
+{
+	iv_run_task_list(st, &st->tasks[IV_TASK_PRIORITY_IDLE]);
+}
+
 void IV_TASK_INIT(struct iv_task *_t)
 {
 	struct iv_task_ *t = (struct iv_task_ *)_t;
 
+	t->priority = IV_TASK_PRIORITY_NORMAL;
 	INIT_IV_LIST_HEAD(&t->list);
 }
 
-void iv_task_register(struct iv_task *_t)
+void iv_loop_task_register(struct iv_loop *loop, struct iv_task *_t)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_task_ *t = (struct iv_task_ *)_t;
 
 	if (!iv_list_empty(&t->list))
 		iv_fatal("iv_task_register: called with task still on a list");
 
+	if (t->priority < IV_TASK_PRIORITY_IDLE ||
+	    t->priority > IV_TASK_PRIORITY_HIGH)
+		iv_fatal("iv_task_register: called with invalid priority %d",
+			 t->priority);
+
 	st->numobjs++;
-	iv_list_add_tail(&t->list, &st->tasks);
+	iv_list_add_tail(&t->list, &st->tasks[t->priority]);
 }
 
-void iv_task_unregister(struct iv_task *_t)
+void iv_task_register(struct iv_task *t)
 {
-	struct iv_state *st = iv_get_state();
+	iv_loop_task_register(iv_get_loop(), t);
+}
+
+void iv_loop_task_unregister(struct iv_loop *loop, struct iv_task *_t)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_task_ *t = (struct iv_task_ *)_t;
 
 	if (iv_list_empty(&t->list))
@@ -80,6 +125,11 @@ void iv_task_unregister(struct iv_task *_t)
 	iv_list_del_init(&t->list);
 }
 
+void iv_task_unregister(struct iv_task *t)
+{
+	iv_loop_task_unregister(iv_get_loop(), t);
+}
+
 int iv_task_registered(struct iv_task *_t)
 {
 	struct iv_task_ *t = (struct iv_task_ *)_t;
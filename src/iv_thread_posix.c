@@ -27,6 +27,7 @@
 #include <pthread.h>
 #include <string.h>
 #include "config.h"
+#include "iv_private.h"
 
 /* thread ID ****************************************************************/
 #ifdef HAVE_PROCESS_H
@@ -213,6 +214,75 @@ out:
 	return -1;
 }
 
+
+/* detached threads *********************************************************/
+struct iv_thread_detached {
+	char			*name;
+	void			(*start_routine)(void *);
+	void			*arg;
+};
+
+static void *iv_thread_detached_handler(void *_thr)
+{
+	struct iv_thread_detached *thr = _thr;
+
+	thr->start_routine(thr->arg);
+
+	if (iv_thread_debug)
+		fprintf(stderr, "iv_thread: [%s] terminating normally\n",
+			thr->name);
+
+	free(thr->name);
+	free(thr);
+
+	return NULL;
+}
+
+/*
+ * Detached threads aren't tracked by the thread that creates them,
+ * and don't need that thread to be running an ivykis event loop.
+ */
+int iv_thread_create_detached(char *name, void (*start_routine)(void *),
+			      void *arg)
+{
+	struct iv_thread_detached *thr;
+	pthread_attr_t attr;
+	pthread_t thread_id;
+	int ret;
+
+	thr = malloc(sizeof(*thr));
+	if (thr == NULL)
+		return -1;
+
+	thr->name = strdup(name);
+	thr->start_routine = start_routine;
+	thr->arg = arg;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread_id, &attr, iv_thread_detached_handler, thr);
+	pthread_attr_destroy(&attr);
+
+	if (ret) {
+		if (iv_thread_debug) {
+			fprintf(stderr, "iv_thread: pthread_create for [%s] "
+					"failed with error %d[%s]\n", name,
+						ret, strerror(ret));
+		}
+
+		free(thr->name);
+		free(thr);
+
+		return -1;
+	}
+
+	if (iv_thread_debug)
+		fprintf(stderr, "iv_thread: [%s] started detached\n", name);
+
+	return 0;
+}
+
+
 void iv_thread_set_debug_state(int state)
 {
 	iv_thread_debug = !!state;
@@ -24,6 +24,7 @@
 #include <iv_thread.h>
 #include <iv_tls.h>
 #include <string.h>
+#include "iv_private.h"
 
 /* data structures and global data ******************************************/
 struct iv_thread {
@@ -146,6 +147,65 @@ out:
 	return -1;
 }
 
+
+/* detached threads *********************************************************/
+struct iv_thread_detached {
+	char			*name;
+	void			(*start_routine)(void *);
+	void			*arg;
+};
+
+static DWORD WINAPI iv_thread_detached_handler(void *_thr)
+{
+	struct iv_thread_detached *thr = _thr;
+
+	thr->start_routine(thr->arg);
+
+	if (iv_thread_debug)
+		fprintf(stderr, "iv_thread: [%s] terminated\n", thr->name);
+
+	free(thr->name);
+	free(thr);
+
+	return 0;
+}
+
+int iv_thread_create_detached(char *name, void (*start_routine)(void *),
+			      void *arg)
+{
+	struct iv_thread_detached *thr;
+	HANDLE h;
+
+	thr = malloc(sizeof(*thr));
+	if (thr == NULL)
+		return -1;
+
+	thr->name = strdup(name);
+	thr->start_routine = start_routine;
+	thr->arg = arg;
+
+	h = CreateThread(NULL, 0, iv_thread_detached_handler, thr, 0, NULL);
+	if (h == NULL) {
+		if (iv_thread_debug) {
+			fprintf(stderr, "iv_thread: [%s] failed to start\n",
+				name);
+		}
+
+		free(thr->name);
+		free(thr);
+
+		return -1;
+	}
+
+	CloseHandle(h);
+
+	if (iv_thread_debug)
+		fprintf(stderr, "iv_thread: [%s] started detached\n", name);
+
+	return 0;
+}
+
+
 void iv_thread_set_debug_state(int state)
 {
 	iv_thread_debug = !!state;
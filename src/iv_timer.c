@@ -38,14 +38,32 @@ void iv_invalidate_now(void)
 	__iv_invalidate_now(st);
 }
 
+void __iv_loop_now_update(struct iv_loop *loop)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+
+	st->time_valid = 1;
+	iv_time_get(&st->time);
+}
+
+void iv_loop_validate_now(struct iv_loop *loop)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+
+	if (!st->time_valid)
+		__iv_loop_now_update(loop);
+}
+
 void iv_validate_now(void)
 {
-	struct iv_state *st = iv_get_state();
+	iv_loop_validate_now(iv_get_loop());
+}
 
-	if (!st->time_valid) {
-		st->time_valid = 1;
-		iv_time_get(&st->time);
-	}
+struct timespec *__iv_loop_now_location(struct iv_loop *loop)
+{
+	struct iv_state *st = iv_loop_to_state(loop);
+
+	return &st->time;
 }
 
 struct timespec *__iv_now_location(void)
@@ -70,12 +88,6 @@ void IV_TIMER_INIT(struct iv_timer *_t)
 	t->index = -1;
 }
 
-static inline int timespec_gt(struct timespec *a, struct timespec *b)
-{
-	return !!(a->tv_sec > b->tv_sec ||
-		 (a->tv_sec == b->tv_sec && a->tv_nsec > b->tv_nsec));
-}
-
 static inline int timer_ptr_gt(struct iv_timer_ *a, struct iv_timer_ *b)
 {
 	return timespec_gt(&a->expires, &b->expires);
@@ -117,7 +129,7 @@ int iv_get_soonest_timeout(struct iv_state *st, struct timespec *to)
 	if (st->num_timers) {
 		struct iv_timer_ *t = *get_node(st, 1);
 
-		iv_validate_now();
+		iv_loop_validate_now(iv_state_to_loop(st));
 		to->tv_sec = t->expires.tv_sec - st->time.tv_sec;
 		to->tv_nsec = t->expires.tv_nsec - st->time.tv_nsec;
 		if (to->tv_nsec < 0) {
@@ -183,9 +195,9 @@ static void pull_up(struct iv_state *st, int index, struct iv_timer_ **i)
 	}
 }
 
-void iv_timer_register(struct iv_timer *_t)
+void iv_loop_timer_register(struct iv_loop *loop, struct iv_timer *_t)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_timer_ *t = (struct iv_timer_ *)_t;
 	struct iv_timer_ **p;
 	int index;
@@ -208,6 +220,11 @@ void iv_timer_register(struct iv_timer *_t)
 	pull_up(st, index, p);
 }
 
+void iv_timer_register(struct iv_timer *t)
+{
+	iv_loop_timer_register(iv_get_loop(), t);
+}
+
 static void push_down(struct iv_state *st, int index, struct iv_timer_ **i)
 {
 	while (1) {
@@ -247,9 +264,9 @@ static void push_down(struct iv_state *st, int index, struct iv_timer_ **i)
 	}
 }
 
-void iv_timer_unregister(struct iv_timer *_t)
+void iv_loop_timer_unregister(struct iv_loop *loop, struct iv_timer *_t)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 	struct iv_timer_ *t = (struct iv_timer_ *)_t;
 	struct iv_timer_ **m;
 	struct iv_timer_ **p;
@@ -286,6 +303,11 @@ void iv_timer_unregister(struct iv_timer *_t)
 	t->index = -1;
 }
 
+void iv_timer_unregister(struct iv_timer *t)
+{
+	iv_loop_timer_unregister(iv_get_loop(), t);
+}
+
 void iv_run_timers(struct iv_state *st)
 {
 	while (st->num_timers) {
@@ -298,7 +320,8 @@ void iv_run_timers(struct iv_state *st)
 
 		if (timespec_gt(&t->expires, &st->time))
 			break;
-		iv_timer_unregister((struct iv_timer *)t);
+		iv_loop_timer_unregister(iv_state_to_loop(st),
+					 (struct iv_timer *)t);
 		t->handler(t->cookie);
 	}
 }
@@ -20,36 +20,84 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 #include <iv_list.h>
 #include <iv_tls.h>
 #include "iv_private.h"
 
 static int inited;
 static int last_offset = (sizeof(struct iv_state) + 15) & ~15;
+static int state_align = 16;
 static struct iv_list_head iv_tls_users = IV_LIST_HEAD_INIT(iv_tls_users);
 
-void iv_tls_user_register(struct iv_tls_user *itu)
+void iv_tls_user_register_aligned(struct iv_tls_user *itu, int align)
 {
 	if (inited)
 		iv_fatal("iv_tls_user_register: called after iv_init");
 
-	itu->state_offset = last_offset;
-	last_offset = (last_offset + itu->sizeof_state + 15) & ~15;
+	if (align <= 0 || (align & (align - 1)))
+		iv_fatal("iv_tls_user_register: invalid alignment %d", align);
+
+	if (align < 16)
+		align = 16;
+
+	/*
+	 * Users that ask for more than the default alignment get their
+	 * state padded out to a multiple of that alignment at both
+	 * ends, so that, for example, state that is written by other
+	 * threads doesn't share cache lines with anything else.
+	 */
+	itu->state_offset = (last_offset + align - 1) & ~(align - 1);
+	last_offset = (itu->state_offset + itu->sizeof_state + align - 1) &
+		      ~(align - 1);
+
+	if (state_align < align)
+		state_align = align;
 
 	iv_list_add_tail(&itu->list, &iv_tls_users);
 }
 
-int iv_tls_total_state_size(void)
+void iv_tls_user_register(struct iv_tls_user *itu)
 {
-	return last_offset;
+	iv_tls_user_register_aligned(itu, 16);
 }
 
-void iv_tls_thread_init(struct iv_state *st)
+struct iv_state *iv_tls_state_alloc(void)
 {
-	struct iv_list_head *ilh;
+	void *st;
 
 	inited = 1;
 
+#ifndef _WIN32
+	if (posix_memalign(&st, state_align, last_offset))
+		return NULL;
+#else
+	st = _aligned_malloc(last_offset, state_align);
+	if (st == NULL)
+		return NULL;
+#endif
+
+	memset(st, 0, last_offset);
+
+	return st;
+}
+
+void iv_tls_state_free(struct iv_state *st)
+{
+#ifndef _WIN32
+	free(st);
+#else
+	_aligned_free(st);
+#endif
+}
+
+void iv_tls_thread_init(struct iv_state *st)
+{
+	struct iv_list_head *ilh;
+
 	iv_list_for_each (ilh, &iv_tls_users) {
 		struct iv_tls_user *itu;
 
@@ -72,9 +120,9 @@ void iv_tls_thread_deinit(struct iv_state *st)
 	}
 }
 
-void *iv_tls_user_ptr(struct iv_tls_user *itu)
+void *iv_loop_tls_user_ptr(struct iv_loop *loop, struct iv_tls_user *itu)
 {
-	struct iv_state *st = iv_get_state();
+	struct iv_state *st = iv_loop_to_state(loop);
 
 	if (itu->state_offset == 0)
 		iv_fatal("iv_tls_user_ptr: called on unregistered iv_tls_user");
@@ -84,3 +132,8 @@ void *iv_tls_user_ptr(struct iv_tls_user *itu)
 
 	return NULL;
 }
+
+void *iv_tls_user_ptr(struct iv_tls_user *itu)
+{
+	return iv_loop_tls_user_ptr(iv_get_loop(), itu);
+}
@@ -0,0 +1,913 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <iv.h>
+#include <iv_list.h>
+#include <iv_tls.h>
+#include <iv_uring_sock.h>
+#include "config.h"
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * Every thread that uses iv_uring_sock gets one io_uring instance,
+ * created when the first socket is registered, with a ring of
+ * BUF_COUNT provided buffers of BUF_SIZE bytes each that receives
+ * are done into.  Submissions are batched up and handed to the
+ * kernel from a task, so that they are submitted once per event
+ * loop iteration, and completions are signaled through an eventfd
+ * that is registered with the ring and polled by the event loop.
+ */
+#define RING_ENTRIES		256
+#define BUF_COUNT		128
+#define BUF_SIZE		4096
+#define BUF_GROUP		0
+
+
+/* syscalls *****************************************************************/
+static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned int opcode, void *arg,
+			     unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+/* thread state handling ****************************************************/
+#define REQ_RECV	0
+#define REQ_SEND	1
+#define REQ_ACCEPT	2
+#define REQ_CONNECT	3
+
+struct iv_uring_req {
+	struct iv_list_head	list;
+	struct iv_list_head	queue;
+	struct iv_uring_sock	*sock;
+	int			op;
+	int			multishot;
+	int			len;
+	int			done;
+	union {
+		struct sockaddr_storage	addr;
+		unsigned char		data[0];
+	} u;
+};
+
+struct iv_uring_thr_info {
+	int			num_socks;
+	int			ring_fd;
+	int			recv_singleshot;
+	int			accept_singleshot;
+
+	unsigned int		*sq_head;
+	unsigned int		*sq_tail;
+	unsigned int		*sq_flags;
+	unsigned int		*sq_array;
+	unsigned int		sq_mask;
+	unsigned int		sq_local_tail;
+	unsigned int		to_submit;
+	struct io_uring_sqe	*sqes;
+
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		cq_mask;
+	struct io_uring_cqe	*cqes;
+
+	void			*sq_ring;
+	size_t			sq_ring_size;
+	void			*cq_ring;
+	size_t			cq_ring_size;
+	size_t			sqes_size;
+
+	struct io_uring_buf_ring *br;
+	size_t			br_size;
+	unsigned short		br_tail;
+	unsigned char		*bufs;
+
+	struct iv_fd		ev;
+	struct iv_task		submit_task;
+	struct iv_list_head	reqs;
+};
+
+static void iv_uring_got_completions(void *_tinfo);
+static void iv_uring_submit(void *_tinfo);
+
+static void iv_uring_tls_init_thread(void *_tinfo)
+{
+	struct iv_uring_thr_info *tinfo = _tinfo;
+
+	tinfo->num_socks = 0;
+	tinfo->ring_fd = -1;
+
+	IV_FD_INIT(&tinfo->ev);
+	tinfo->ev.fd = -1;
+	tinfo->ev.cookie = tinfo;
+	tinfo->ev.handler_in = iv_uring_got_completions;
+
+	IV_TASK_INIT(&tinfo->submit_task);
+	tinfo->submit_task.cookie = tinfo;
+	tinfo->submit_task.handler = iv_uring_submit;
+
+	INIT_IV_LIST_HEAD(&tinfo->reqs);
+}
+
+static void ring_destroy(struct iv_uring_thr_info *tinfo);
+
+static void iv_uring_tls_deinit_thread(void *_tinfo)
+{
+	struct iv_uring_thr_info *tinfo = _tinfo;
+
+	if (tinfo->ring_fd == -1)
+		return;
+
+	/*
+	 * Closing the ring cancels all requests that are still in
+	 * flight, after which they can be freed.
+	 */
+	ring_destroy(tinfo);
+
+	while (!iv_list_empty(&tinfo->reqs)) {
+		struct iv_uring_req *req;
+
+		req = iv_container_of(tinfo->reqs.next,
+				      struct iv_uring_req, list);
+		iv_list_del(&req->list);
+		free(req);
+	}
+}
+
+static struct iv_tls_user iv_uring_tls_user = {
+	.sizeof_state	= sizeof(struct iv_uring_thr_info),
+	.init_thread	= iv_uring_tls_init_thread,
+	.deinit_thread	= iv_uring_tls_deinit_thread,
+};
+
+static void iv_uring_tls_init(void) __attribute__((constructor));
+static void iv_uring_tls_init(void)
+{
+	iv_tls_user_register(&iv_uring_tls_user);
+}
+
+
+/* ring setup ***************************************************************/
+static void *ring_map(int fd, size_t size, off_t offset)
+{
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, fd, offset);
+
+	return (ptr != MAP_FAILED) ? ptr : NULL;
+}
+
+static void *ring_ptr(void *ring, unsigned int offset)
+{
+	return (unsigned char *)ring + offset;
+}
+
+static void buf_put(struct iv_uring_thr_info *tinfo, int bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &tinfo->br->bufs[tinfo->br_tail & (BUF_COUNT - 1)];
+	buf->addr = (unsigned long)(tinfo->bufs + bid * BUF_SIZE);
+	buf->len = BUF_SIZE;
+	buf->bid = bid;
+
+	tinfo->br_tail++;
+	__atomic_store_n(&tinfo->br->tail, tinfo->br_tail, __ATOMIC_RELEASE);
+}
+
+static int ring_init(struct iv_uring_thr_info *tinfo)
+{
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	int fd;
+	int i;
+
+	memset(&p, 0, sizeof(p));
+
+	fd = io_uring_setup(RING_ENTRIES, &p);
+	if (fd < 0)
+		return -1;
+
+	tinfo->ring_fd = fd;
+	tinfo->sq_ring = NULL;
+	tinfo->cq_ring = NULL;
+	tinfo->sqes = NULL;
+	tinfo->br = NULL;
+	tinfo->bufs = NULL;
+
+	tinfo->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(__u32);
+	tinfo->cq_ring_size = p.cq_off.cqes +
+			      p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (tinfo->sq_ring_size < tinfo->cq_ring_size)
+			tinfo->sq_ring_size = tinfo->cq_ring_size;
+		tinfo->cq_ring_size = tinfo->sq_ring_size;
+	}
+
+	tinfo->sq_ring = ring_map(fd, tinfo->sq_ring_size, IORING_OFF_SQ_RING);
+	if (tinfo->sq_ring == NULL)
+		goto err;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		tinfo->cq_ring = tinfo->sq_ring;
+	} else {
+		tinfo->cq_ring = ring_map(fd, tinfo->cq_ring_size,
+					  IORING_OFF_CQ_RING);
+		if (tinfo->cq_ring == NULL)
+			goto err;
+	}
+
+	tinfo->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	tinfo->sqes = ring_map(fd, tinfo->sqes_size, IORING_OFF_SQES);
+	if (tinfo->sqes == NULL)
+		goto err;
+
+	tinfo->sq_head = ring_ptr(tinfo->sq_ring, p.sq_off.head);
+	tinfo->sq_tail = ring_ptr(tinfo->sq_ring, p.sq_off.tail);
+	tinfo->sq_flags = ring_ptr(tinfo->sq_ring, p.sq_off.flags);
+	tinfo->sq_array = ring_ptr(tinfo->sq_ring, p.sq_off.array);
+	tinfo->sq_mask = p.sq_entries - 1;
+	tinfo->sq_local_tail = *tinfo->sq_tail;
+	tinfo->to_submit = 0;
+
+	tinfo->cq_head = ring_ptr(tinfo->cq_ring, p.cq_off.head);
+	tinfo->cq_tail = ring_ptr(tinfo->cq_ring, p.cq_off.tail);
+	tinfo->cq_mask = p.cq_entries - 1;
+	tinfo->cqes = ring_ptr(tinfo->cq_ring, p.cq_off.cqes);
+
+	tinfo->ev.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (tinfo->ev.fd < 0)
+		goto err;
+
+	if (io_uring_register(fd, IORING_REGISTER_EVENTFD, &tinfo->ev.fd, 1))
+		goto err;
+
+	tinfo->br_size = BUF_COUNT * sizeof(struct io_uring_buf);
+	tinfo->br = mmap(NULL, tinfo->br_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (tinfo->br == MAP_FAILED) {
+		tinfo->br = NULL;
+		goto err;
+	}
+
+	tinfo->bufs = malloc(BUF_COUNT * BUF_SIZE);
+	if (tinfo->bufs == NULL)
+		goto err;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)tinfo->br;
+	reg.ring_entries = BUF_COUNT;
+	reg.bgid = BUF_GROUP;
+	if (io_uring_register(fd, IORING_REGISTER_PBUF_RING, &reg, 1))
+		goto err;
+
+	tinfo->br_tail = 0;
+	for (i = 0; i < BUF_COUNT; i++)
+		buf_put(tinfo, i);
+
+	tinfo->recv_singleshot = 0;
+	tinfo->accept_singleshot = 0;
+
+	return 0;
+
+err:
+	i = errno;
+	ring_destroy(tinfo);
+	errno = i;
+
+	return -1;
+}
+
+static void ring_destroy(struct iv_uring_thr_info *tinfo)
+{
+	close(tinfo->ring_fd);
+	tinfo->ring_fd = -1;
+
+	if (tinfo->ev.fd != -1) {
+		close(tinfo->ev.fd);
+		tinfo->ev.fd = -1;
+	}
+
+	if (tinfo->sqes != NULL)
+		munmap(tinfo->sqes, tinfo->sqes_size);
+	if (tinfo->cq_ring != NULL && tinfo->cq_ring != tinfo->sq_ring)
+		munmap(tinfo->cq_ring, tinfo->cq_ring_size);
+	if (tinfo->sq_ring != NULL)
+		munmap(tinfo->sq_ring, tinfo->sq_ring_size);
+	if (tinfo->br != NULL)
+		munmap(tinfo->br, tinfo->br_size);
+	free(tinfo->bufs);
+}
+
+
+/* submission ***************************************************************/
+static void submit(struct iv_uring_thr_info *tinfo)
+{
+	while (tinfo->to_submit) {
+		int ret;
+
+		ret = io_uring_enter(tinfo->ring_fd, tinfo->to_submit, 0, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			/*
+			 * The completion queue is backed up, so try
+			 * again once it has been drained.
+			 */
+			if (errno == EAGAIN || errno == EBUSY)
+				break;
+
+			iv_fatal("iv_uring_sock: io_uring_enter returned "
+				 "error %d[%s]", errno, strerror(errno));
+		}
+
+		if (ret == 0)
+			break;
+
+		tinfo->to_submit -= ret;
+	}
+}
+
+static void iv_uring_submit(void *_tinfo)
+{
+	submit(_tinfo);
+}
+
+static int sq_full(struct iv_uring_thr_info *tinfo)
+{
+	unsigned int head;
+
+	head = __atomic_load_n(tinfo->sq_head, __ATOMIC_ACQUIRE);
+
+	return tinfo->sq_local_tail - head > tinfo->sq_mask;
+}
+
+static struct io_uring_sqe *
+get_sqe(struct iv_uring_thr_info *tinfo, struct iv_uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+	unsigned int idx;
+
+	if (sq_full(tinfo)) {
+		submit(tinfo);
+		if (sq_full(tinfo))
+			iv_fatal("iv_uring_sock: submission queue full");
+	}
+
+	idx = tinfo->sq_local_tail & tinfo->sq_mask;
+
+	sqe = &tinfo->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = (unsigned long)req;
+
+	tinfo->sq_array[idx] = idx;
+
+	return sqe;
+}
+
+static void commit_sqe(struct iv_uring_thr_info *tinfo)
+{
+	tinfo->sq_local_tail++;
+	__atomic_store_n(tinfo->sq_tail, tinfo->sq_local_tail,
+			 __ATOMIC_RELEASE);
+
+	if (!tinfo->to_submit++)
+		iv_task_register(&tinfo->submit_task);
+}
+
+static void queue_recv(struct iv_uring_thr_info *tinfo,
+		       struct iv_uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(tinfo, req);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->fd = req->sock->fd;
+	sqe->buf_group = BUF_GROUP;
+
+	req->multishot = !tinfo->recv_singleshot;
+	if (req->multishot)
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+
+	commit_sqe(tinfo);
+}
+
+static void queue_send(struct iv_uring_thr_info *tinfo,
+		       struct iv_uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(tinfo, req);
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = req->sock->fd;
+	sqe->addr = (unsigned long)(req->u.data + req->done);
+	sqe->len = req->len - req->done;
+	sqe->msg_flags = MSG_NOSIGNAL;
+
+	commit_sqe(tinfo);
+}
+
+static void queue_accept(struct iv_uring_thr_info *tinfo,
+			 struct iv_uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(tinfo, req);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = req->sock->fd;
+	sqe->accept_flags = SOCK_CLOEXEC;
+
+	req->multishot = !tinfo->accept_singleshot;
+	if (req->multishot)
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+
+	commit_sqe(tinfo);
+}
+
+static void queue_connect(struct iv_uring_thr_info *tinfo,
+			  struct iv_uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(tinfo, req);
+	sqe->opcode = IORING_OP_CONNECT;
+	sqe->fd = req->sock->fd;
+	sqe->addr = (unsigned long)&req->u.addr;
+	sqe->off = req->len;
+
+	commit_sqe(tinfo);
+}
+
+static void queue_cancel(struct iv_uring_thr_info *tinfo,
+			 struct iv_uring_req *req)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = get_sqe(tinfo, NULL);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (unsigned long)req;
+
+	commit_sqe(tinfo);
+}
+
+
+/* completion ***************************************************************/
+static void req_free(struct iv_uring_req *req)
+{
+	iv_list_del(&req->list);
+	free(req);
+}
+
+static void complete_recv(struct iv_uring_thr_info *tinfo,
+			  struct iv_uring_req *req, struct io_uring_cqe *cqe)
+{
+	struct iv_uring_sock *sock = req->sock;
+	int res = cqe->res;
+	int bid;
+	int rearm;
+
+	bid = -1;
+	if (cqe->flags & IORING_CQE_F_BUFFER)
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+	/*
+	 * Multishot receives can be terminated by the kernel at any
+	 * time, for example when it runs out of provided buffers, in
+	 * which case we just start over.  If the kernel doesn't know
+	 * about multishot receives at all, we fall back to rearming
+	 * the receive after every completion.
+	 */
+	rearm = 0;
+	if (!(cqe->flags & IORING_CQE_F_MORE) && sock != NULL) {
+		if (res > 0 || res == -ENOBUFS) {
+			rearm = 1;
+		} else if (res == -EINVAL && req->multishot &&
+			   !tinfo->recv_singleshot) {
+			tinfo->recv_singleshot = 1;
+			rearm = 1;
+		}
+	}
+
+	if (rearm)
+		queue_recv(tinfo, req);
+	else if (!(cqe->flags & IORING_CQE_F_MORE) && sock != NULL)
+		sock->recv_req = NULL;
+
+	if (sock != NULL && res != -ENOBUFS && !(rearm && res < 0)) {
+		sock->handler_recv(sock->cookie,
+				   (bid >= 0) ? tinfo->bufs + bid * BUF_SIZE
+					      : NULL, res);
+	}
+
+	if (bid >= 0)
+		buf_put(tinfo, bid);
+
+	if (!(cqe->flags & IORING_CQE_F_MORE) && !rearm)
+		req_free(req);
+}
+
+static void complete_send(struct iv_uring_thr_info *tinfo,
+			  struct iv_uring_req *req, struct io_uring_cqe *cqe)
+{
+	struct iv_uring_sock *sock = req->sock;
+	int res = cqe->res;
+
+	if (sock == NULL) {
+		req_free(req);
+		return;
+	}
+
+	if (res > 0) {
+		req->done += res;
+		if (req->done < req->len) {
+			queue_send(tinfo, req);
+			return;
+		}
+		res = req->done;
+	}
+
+	iv_list_del(&req->queue);
+	req_free(req);
+
+	if (!iv_list_empty(&sock->sends)) {
+		req = iv_container_of(sock->sends.next,
+				      struct iv_uring_req, queue);
+		queue_send(tinfo, req);
+	}
+
+	if (sock->handler_send != NULL)
+		sock->handler_send(sock->cookie, res);
+}
+
+static void complete_accept(struct iv_uring_thr_info *tinfo,
+			    struct iv_uring_req *req, struct io_uring_cqe *cqe)
+{
+	struct iv_uring_sock *sock = req->sock;
+	int res = cqe->res;
+
+	/*
+	 * As with receives, if the kernel doesn't know about
+	 * multishot accepts, fall back to rearming the accept after
+	 * every completion.
+	 */
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		if (sock != NULL && res == -EINVAL && req->multishot &&
+		    !tinfo->accept_singleshot) {
+			tinfo->accept_singleshot = 1;
+			queue_accept(tinfo, req);
+			return;
+		}
+
+		if (sock != NULL && res >= 0) {
+			queue_accept(tinfo, req);
+		} else {
+			if (sock != NULL)
+				sock->accept_req = NULL;
+			req_free(req);
+		}
+	}
+
+	if (sock != NULL)
+		sock->handler_accept(sock->cookie, res);
+	else if (res >= 0)
+		close(res);
+}
+
+static void complete_connect(struct iv_uring_thr_info *tinfo,
+			     struct iv_uring_req *req, struct io_uring_cqe *cqe)
+{
+	struct iv_uring_sock *sock = req->sock;
+
+	req_free(req);
+
+	if (sock != NULL) {
+		sock->connect_req = NULL;
+		sock->handler_connect(sock->cookie, cqe->res);
+	}
+}
+
+static void complete(struct iv_uring_thr_info *tinfo,
+		     struct io_uring_cqe *cqe)
+{
+	struct iv_uring_req *req;
+
+	req = (struct iv_uring_req *)(unsigned long)cqe->user_data;
+	if (req == NULL)
+		return;
+
+	switch (req->op) {
+	case REQ_RECV:
+		complete_recv(tinfo, req, cqe);
+		break;
+	case REQ_SEND:
+		complete_send(tinfo, req, cqe);
+		break;
+	case REQ_ACCEPT:
+		complete_accept(tinfo, req, cqe);
+		break;
+	case REQ_CONNECT:
+		complete_connect(tinfo, req, cqe);
+		break;
+	}
+}
+
+static void iv_uring_got_completions(void *_tinfo)
+{
+	struct iv_uring_thr_info *tinfo = _tinfo;
+	uint64_t count;
+
+	if (read(tinfo->ev.fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+		iv_fatal("iv_uring_sock: reading from eventfd returned "
+			 "error %d[%s]", errno, strerror(errno));
+
+	while (1) {
+		unsigned int head;
+
+		head = *tinfo->cq_head;
+		while (head != __atomic_load_n(tinfo->cq_tail,
+					       __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe cqe;
+
+			cqe = tinfo->cqes[head & tinfo->cq_mask];
+
+			head++;
+			__atomic_store_n(tinfo->cq_head, head,
+					 __ATOMIC_RELEASE);
+
+			complete(tinfo, &cqe);
+		}
+
+		if (!(__atomic_load_n(tinfo->sq_flags, __ATOMIC_RELAXED) &
+		      IORING_SQ_CQ_OVERFLOW)) {
+			break;
+		}
+
+		io_uring_enter(tinfo->ring_fd, 0, 0, IORING_ENTER_GETEVENTS);
+	}
+
+	if (tinfo->to_submit && !iv_task_registered(&tinfo->submit_task))
+		iv_task_register(&tinfo->submit_task);
+}
+
+
+/* public use ***************************************************************/
+int iv_uring_sock_register(struct iv_uring_sock *this)
+{
+	struct iv_uring_thr_info *tinfo;
+
+	tinfo = iv_tls_user_ptr(&iv_uring_tls_user);
+	if (tinfo->ring_fd == -1 && ring_init(tinfo) < 0)
+		return -1;
+
+	if (!tinfo->num_socks++)
+		iv_fd_register(&tinfo->ev);
+
+	this->tinfo = tinfo;
+	this->recv_req = NULL;
+	this->accept_req = NULL;
+	this->connect_req = NULL;
+	INIT_IV_LIST_HEAD(&this->sends);
+
+	return 0;
+}
+
+static void orphan(struct iv_uring_thr_info *tinfo, struct iv_uring_req *req)
+{
+	req->sock = NULL;
+	queue_cancel(tinfo, req);
+}
+
+void iv_uring_sock_unregister(struct iv_uring_sock *this)
+{
+	struct iv_uring_thr_info *tinfo = this->tinfo;
+	struct iv_list_head *first;
+	struct iv_list_head *ilh;
+	struct iv_list_head *ilh2;
+
+	/*
+	 * Requests that are in flight are cancelled, and their
+	 * completions, which may still arrive later, are dropped.
+	 */
+	if (this->recv_req != NULL)
+		orphan(tinfo, this->recv_req);
+
+	if (this->accept_req != NULL)
+		orphan(tinfo, this->accept_req);
+
+	if (this->connect_req != NULL)
+		orphan(tinfo, this->connect_req);
+
+	first = this->sends.next;
+	iv_list_for_each_safe (ilh, ilh2, &this->sends) {
+		struct iv_uring_req *req;
+
+		req = iv_container_of(ilh, struct iv_uring_req, queue);
+		iv_list_del(&req->queue);
+
+		if (ilh == first)
+			orphan(tinfo, req);
+		else
+			req_free(req);
+	}
+
+	if (!--tinfo->num_socks)
+		iv_fd_unregister(&tinfo->ev);
+}
+
+static struct iv_uring_req *
+req_alloc(struct iv_uring_sock *this, int op, int extra)
+{
+	struct iv_uring_thr_info *tinfo = this->tinfo;
+	struct iv_uring_req *req;
+
+	req = malloc(sizeof(*req) + extra);
+	if (req == NULL)
+		return NULL;
+
+	iv_list_add_tail(&req->list, &tinfo->reqs);
+	INIT_IV_LIST_HEAD(&req->queue);
+	req->sock = this;
+	req->op = op;
+	req->multishot = 0;
+	req->len = 0;
+	req->done = 0;
+
+	return req;
+}
+
+int iv_uring_sock_recv(struct iv_uring_sock *this)
+{
+	struct iv_uring_req *req;
+
+	if (this->recv_req != NULL)
+		iv_fatal("iv_uring_sock_recv: already receiving");
+
+	req = req_alloc(this, REQ_RECV, 0);
+	if (req == NULL)
+		return -1;
+
+	this->recv_req = req;
+	queue_recv(this->tinfo, req);
+
+	return 0;
+}
+
+int iv_uring_sock_send(struct iv_uring_sock *this, const void *buf, int len)
+{
+	struct iv_uring_req *req;
+	int idle;
+
+	if (len <= 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	req = req_alloc(this, REQ_SEND, len);
+	if (req == NULL)
+		return -1;
+
+	memcpy(req->u.data, buf, len);
+	req->len = len;
+
+	/*
+	 * Only one send per socket is kept in flight at any time, as
+	 * the kernel doesn't guarantee that concurrent sends on the
+	 * same socket complete in submission order.
+	 */
+	idle = iv_list_empty(&this->sends);
+	iv_list_add_tail(&req->queue, &this->sends);
+	if (idle)
+		queue_send(this->tinfo, req);
+
+	return 0;
+}
+
+int iv_uring_sock_accept(struct iv_uring_sock *this)
+{
+	struct iv_uring_req *req;
+
+	if (this->accept_req != NULL)
+		iv_fatal("iv_uring_sock_accept: already accepting");
+
+	req = req_alloc(this, REQ_ACCEPT, 0);
+	if (req == NULL)
+		return -1;
+
+	this->accept_req = req;
+	queue_accept(this->tinfo, req);
+
+	return 0;
+}
+
+int iv_uring_sock_connect(struct iv_uring_sock *this,
+			  const struct sockaddr *addr, socklen_t addrlen)
+{
+	struct iv_uring_req *req;
+
+	if (this->connect_req != NULL)
+		iv_fatal("iv_uring_sock_connect: already connecting");
+
+	if (addrlen > sizeof(req->u.addr)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	req = req_alloc(this, REQ_CONNECT, 0);
+	if (req == NULL)
+		return -1;
+
+	memcpy(&req->u.addr, addr, addrlen);
+	req->len = addrlen;
+
+	this->connect_req = req;
+	queue_connect(this->tinfo, req);
+
+	return 0;
+}
+
+#else
+
+/*
+ * Without io_uring support, iv_uring_sock is built as a stub, so that
+ * the library exports the same symbols everywhere and applications can
+ * detect the missing support at run time.
+ */
+int iv_uring_sock_register(struct iv_uring_sock *this)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+void iv_uring_sock_unregister(struct iv_uring_sock *this)
+{
+}
+
+int iv_uring_sock_recv(struct iv_uring_sock *this)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int iv_uring_sock_send(struct iv_uring_sock *this, const void *buf, int len)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int iv_uring_sock_accept(struct iv_uring_sock *this)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+int iv_uring_sock_connect(struct iv_uring_sock *this,
+			  const struct sockaddr *addr, socklen_t addrlen)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <iv.h>
+#include <iv_avl.h>
 #include <iv_event.h>
 #include <iv_list.h>
 #include <iv_thread.h>
@@ -31,18 +32,40 @@
 #include "mutex.h"
 
 /* data structures **********************************************************/
+#define DEFAULT_IDLE_TIMEOUT	10000
+#define NUM_PRIORITIES		(IV_WORK_PRIORITY_HIGH + 1)
+
 struct work_pool_priv {
 	__mutex_t		lock;
 	struct iv_event		ev;
+	struct iv_timer		grow_timer;
 	int			shutting_down;
+	int			max_threads;
+	int			min_threads;
+	int			idle_timeout;
+	int			max_queue_latency;
+	int			max_queue_depth;
+	int			queue_policy;
+	int			queue_low_watermark;
+	int			space_wanted;
+	int			space_ready;
+	int			lightweight;
+	int			shared;
+	int			refs;
 	int			started_threads;
 	struct iv_list_head	idle_threads;
 	void			*cookie;
 	void			(*thread_start)(void *cookie);
 	void			(*thread_stop)(void *cookie);
+	void			(*space_available)(void *cookie);
+	int			max_completions;
+	void			(*completion_batch)(void *cookie,
+						    struct iv_work_item **items,
+						    int num_items);
 	uint32_t		seq_head;
 	uint32_t		seq_tail;
-	struct iv_list_head	work_items;
+	struct iv_list_head	work_items[NUM_PRIORITIES];
+	struct iv_avl_tree	deadline_items[NUM_PRIORITIES];
 	struct iv_list_head	work_done;
 };
 
@@ -53,9 +76,222 @@ struct work_pool_thread {
 	struct iv_event		kick;
 	struct iv_task		work_task;
 	struct iv_timer		idle_timer;
+	__cond_t		cond;
+};
+
+struct iv_work_thr_info {
+	struct iv_task		task;
+	struct iv_list_head	work_items;
+
+	int			shared_items;
+	struct iv_event		shared_ev;
+	__mutex_t		shared_lock;
+	struct iv_list_head	shared_done;
 };
 
 
+/* work queue ***************************************************************/
+static int iv_work_item_has_deadline(struct iv_work_item *work)
+{
+	return work->deadline.tv_sec || work->deadline.tv_nsec;
+}
+
+/*
+ * Work items that are part of a group are always run, as the group's
+ * completion has no way of reporting that some of its work items were
+ * skipped, and their deadline only determines their queueing order.
+ */
+static int iv_work_item_may_expire(struct iv_work_item *work)
+{
+	return work->group == NULL && iv_work_item_has_deadline(work);
+}
+
+static int
+iv_work_item_compare(struct iv_avl_node *_a, struct iv_avl_node *_b)
+{
+	struct iv_work_item *a = iv_container_of(_a, struct iv_work_item,
+						 avl_node);
+	struct iv_work_item *b = iv_container_of(_b, struct iv_work_item,
+						 avl_node);
+
+	if (timespec_gt(&a->deadline, &b->deadline))
+		return 1;
+
+	if (timespec_gt(&b->deadline, &a->deadline))
+		return -1;
+
+	/*
+	 * Items with equal deadlines are run in submission order.
+	 */
+	if ((int32_t)(a->seq - b->seq) < 0)
+		return -1;
+
+	if ((int32_t)(a->seq - b->seq) > 0)
+		return 1;
+
+	return 0;
+}
+
+static void iv_work_queue_init(struct work_pool_priv *pool)
+{
+	int i;
+
+	pool->seq_head = 0;
+	pool->seq_tail = 0;
+
+	for (i = 0; i < NUM_PRIORITIES; i++) {
+		INIT_IV_LIST_HEAD(&pool->work_items[i]);
+		INIT_IV_AVL_TREE(&pool->deadline_items[i],
+				 iv_work_item_compare);
+	}
+}
+
+static int iv_work_queue_empty(struct work_pool_priv *pool)
+{
+	return pool->seq_head == pool->seq_tail;
+}
+
+static int iv_work_queue_depth(struct work_pool_priv *pool)
+{
+	return (int32_t)(pool->seq_tail - pool->seq_head);
+}
+
+/*
+ * Work items are kept in one queue per priority class.  Within each
+ * class, items that have a deadline are kept in a tree ordered by
+ * deadline, and are run before items without a deadline, which are
+ * kept on a plain FIFO list.
+ */
+static void
+iv_work_queue_item(struct work_pool_priv *pool, struct iv_work_item *work)
+{
+	if (work->priority < IV_WORK_PRIORITY_LOW)
+		work->priority = IV_WORK_PRIORITY_LOW;
+	else if (work->priority > IV_WORK_PRIORITY_HIGH)
+		work->priority = IV_WORK_PRIORITY_HIGH;
+
+	work->seq = pool->seq_tail++;
+	work->pool = pool;
+	work->queued = 1;
+
+	if (iv_work_item_has_deadline(work)) {
+		iv_avl_tree_insert(&pool->deadline_items[work->priority],
+				   &work->avl_node);
+	} else {
+		iv_list_add_tail(&work->list,
+				 &pool->work_items[work->priority]);
+	}
+}
+
+/*
+ * Removing an item from the queue, be it because a worker thread
+ * picked it up or because it was canceled, counts as consuming it,
+ * so that worker threads that took a snapshot of ->seq_tail never
+ * try to dequeue more items than there are left in the queue.
+ */
+static void
+iv_work_unqueue_item(struct work_pool_priv *pool, struct iv_work_item *work)
+{
+	if (iv_work_item_has_deadline(work)) {
+		iv_avl_tree_delete(&pool->deadline_items[work->priority],
+				   &work->avl_node);
+	} else {
+		iv_list_del(&work->list);
+	}
+
+	pool->seq_head++;
+	work->queued = 0;
+
+	/*
+	 * If a submission was turned away because the queue was full,
+	 * let the pool owner know once the queue has drained to below
+	 * its low watermark.
+	 */
+	if (pool->space_wanted &&
+	    iv_work_queue_depth(pool) <= pool->queue_low_watermark) {
+		pool->space_wanted = 0;
+		pool->space_ready = 1;
+		iv_event_post(&pool->ev);
+	}
+}
+
+static struct iv_work_item *iv_work_dequeue_item(struct work_pool_priv *pool)
+{
+	int i;
+
+	for (i = IV_WORK_PRIORITY_HIGH; i >= IV_WORK_PRIORITY_LOW; i--) {
+		struct iv_avl_node *an;
+		struct iv_work_item *work;
+
+		an = iv_avl_tree_min(&pool->deadline_items[i]);
+		if (an != NULL) {
+			work = iv_container_of(an, struct iv_work_item,
+					       avl_node);
+			iv_work_unqueue_item(pool, work);
+			return work;
+		}
+
+		if (!iv_list_empty(&pool->work_items[i])) {
+			work = iv_container_of(pool->work_items[i].next,
+					       struct iv_work_item, list);
+			iv_work_unqueue_item(pool, work);
+			return work;
+		}
+	}
+
+	iv_fatal("iv_work_dequeue_item: called on empty queue");
+}
+
+/*
+ * Finds the work item that has been queued for the longest, going by
+ * the ->submitted timestamps, which are only maintained for pools that
+ * need them.  If there is a tie, lower priority work items win.  If
+ * @droppable is set, work items that are part of a group are skipped,
+ * as dropping those would let their group complete without them
+ * having run, and NULL is returned if there are no other work items.
+ */
+static struct iv_work_item *
+iv_work_oldest_item(struct work_pool_priv *pool, int droppable)
+{
+	struct iv_work_item *oldest;
+	int i;
+
+	oldest = NULL;
+	for (i = 0; i < NUM_PRIORITIES; i++) {
+		struct iv_avl_node *an;
+		struct iv_list_head *ilh;
+		struct iv_work_item *work;
+
+		an = iv_avl_tree_min(&pool->deadline_items[i]);
+		while (an != NULL) {
+			work = iv_container_of(an, struct iv_work_item,
+					       avl_node);
+			if (!droppable || work->group == NULL) {
+				if (oldest == NULL ||
+				    timespec_gt(&oldest->submitted,
+						&work->submitted))
+					oldest = work;
+				break;
+			}
+			an = iv_avl_tree_next(an);
+		}
+
+		iv_list_for_each (ilh, &pool->work_items[i]) {
+			work = iv_container_of(ilh, struct iv_work_item, list);
+			if (!droppable || work->group == NULL) {
+				if (oldest == NULL ||
+				    timespec_gt(&oldest->submitted,
+						&work->submitted))
+					oldest = work;
+				break;
+			}
+		}
+	}
+
+	return oldest;
+}
+
+
 /* worker thread ************************************************************/
 static void iv_work_thread_got_event(void *_thr)
 {
@@ -69,12 +305,102 @@ static void iv_work_thread_got_event(void *_thr)
 	if (!iv_list_empty(&thr->list)) {
 		iv_list_del_init(&thr->list);
 		iv_task_register(&thr->work_task);
-		iv_timer_unregister(&thr->idle_timer);
+		if (iv_timer_registered(&thr->idle_timer))
+			iv_timer_unregister(&thr->idle_timer);
 	}
 
 	mutex_unlock(&pool->lock);
 }
 
+/*
+ * Completed work items are handed back to the thread that owns the
+ * pool, or for shared pools, to the thread that submitted the item.
+ */
+static void
+iv_work_complete_item(struct work_pool_priv *pool, struct iv_work_item *work)
+{
+	struct iv_work_thr_info *tinfo = work->owner;
+
+	if (!pool->shared) {
+		if (iv_list_empty(&pool->work_done))
+			iv_event_post(&pool->ev);
+		iv_list_add_tail(&work->list, &pool->work_done);
+		return;
+	}
+
+	mutex_lock(&tinfo->shared_lock);
+	if (iv_list_empty(&tinfo->shared_done))
+		iv_event_post(&tinfo->shared_ev);
+	iv_list_add_tail(&work->list, &tinfo->shared_done);
+	mutex_unlock(&tinfo->shared_lock);
+}
+
+static void iv_work_group_complete(void *_group);
+
+static int iv_work_item_is_group(struct iv_work_item *work)
+{
+	return work->completion == iv_work_group_complete;
+}
+
+/*
+ * Work items that are part of a group don't have their completions
+ * reported individually.  Instead, the group's completion is reported
+ * once all of its work items have run and the group has been joined.
+ */
+static void
+iv_work_group_item_done(struct work_pool_priv *pool, struct iv_work_item *work)
+{
+	struct iv_work_group *group = work->group;
+
+	if (!--group->pending)
+		iv_work_complete_item(pool, &group->done);
+}
+
+/*
+ * Work items that are taken off the queue without being run, be it
+ * because they were canceled or because they were dropped to make
+ * room for new work, still count as done for their group, if any.
+ * Only cancellation can do this to a work item that is part of a
+ * group, as group members are never dropped.
+ */
+static void iv_work_item_not_run(struct work_pool_priv *pool,
+				 struct iv_work_item *work, int status)
+{
+	work->status = status;
+	if (work->group != NULL)
+		iv_work_group_item_done(pool, work);
+	else
+		iv_work_complete_item(pool, work);
+}
+
+static void iv_work_pool_free(struct work_pool_priv *pool)
+{
+	mutex_destroy(&pool->lock);
+	if (!pool->shared) {
+		if (iv_timer_registered(&pool->grow_timer))
+			iv_timer_unregister(&pool->grow_timer);
+		iv_event_unregister(&pool->ev);
+	}
+	free(pool);
+}
+
+/*
+ * Drops a reference on a shared pool that was taken by
+ * iv_work_shared_get(), freeing the pool if it was put and
+ * all its threads have exited.
+ */
+static void iv_work_pool_unref(struct work_pool_priv *pool)
+{
+	int last;
+
+	mutex_lock(&pool->lock);
+	last = !--pool->refs && pool->shutting_down && !pool->started_threads;
+	mutex_unlock(&pool->lock);
+
+	if (last)
+		iv_work_pool_free(pool);
+}
+
 static void __iv_work_thread_die(struct work_pool_thread *thr)
 {
 	struct work_pool_priv *pool = thr->pool;
@@ -85,7 +411,10 @@ static void __iv_work_thread_die(struct work_pool_thread *thr)
 	if (!iv_list_empty(&thr->list))
 		iv_fatal("__iv_work_thread_die: thread still on list");
 
-	iv_event_unregister(&thr->kick);
+	if (!pool->lightweight)
+		iv_event_unregister(&thr->kick);
+	else
+		cond_destroy(&thr->cond);
 	free(thr);
 
 	pool->started_threads--;
@@ -93,10 +422,66 @@ static void __iv_work_thread_die(struct work_pool_thread *thr)
 	if (pool->thread_stop != NULL)
 		pool->thread_stop(pool->cookie);
 
-	if (pool->shutting_down && !pool->started_threads)
+	if (pool->shutting_down && !pool->started_threads && !pool->shared)
 		iv_event_post(&pool->ev);
 }
 
+/*
+ * Idle threads always arm their idle timer, even if the pool is at
+ * its minimum size when they go idle, as the pool may have grown by
+ * the time the timer expires.  Whether the thread should exit is
+ * only decided when the timer expires.
+ */
+static void iv_work_thread_arm_idle_timer(struct work_pool_thread *thr)
+{
+	struct work_pool_priv *pool = thr->pool;
+
+	iv_validate_now();
+	thr->idle_timer.expires = iv_now;
+	timespec_add_ms(&thr->idle_timer.expires, pool->idle_timeout);
+	iv_timer_register(&thr->idle_timer);
+}
+
+static void iv_work_thread_run_item(struct work_pool_priv *pool)
+{
+	struct iv_work_item *work;
+
+	work = iv_work_dequeue_item(pool);
+
+	if (iv_work_item_may_expire(work)) {
+		struct timespec now;
+
+		iv_time_get(&now);
+		if (!timespec_gt(&work->deadline, &now))
+			work->status = IV_WORK_STATUS_EXPIRED;
+	}
+
+	if (work->status != IV_WORK_STATUS_EXPIRED) {
+		struct timespec start;
+
+		if (work->timeout)
+			iv_time_get(&start);
+
+		mutex_unlock(&pool->lock);
+		work->work(work->cookie);
+		mutex_lock(&pool->lock);
+
+		if (work->timeout) {
+			struct timespec now;
+
+			iv_time_get(&now);
+			timespec_add_ms(&start, work->timeout);
+			if (timespec_gt(&now, &start))
+				work->status = IV_WORK_STATUS_OVERRUN;
+		}
+	}
+
+	if (work->group != NULL)
+		iv_work_group_item_done(pool, work);
+	else
+		iv_work_complete_item(pool, work);
+}
+
 static void iv_work_thread_do_work(void *_thr)
 {
 	struct work_pool_thread *thr = _thr;
@@ -107,30 +492,14 @@ static void iv_work_thread_do_work(void *_thr)
 
 	last_seq = pool->seq_tail;
 	while ((int32_t)(last_seq - pool->seq_head) > 0) {
-		struct iv_work_item *work;
-
-		pool->seq_head++;
-		work = iv_container_of(pool->work_items.next,
-				       struct iv_work_item, list);
-		iv_list_del(&work->list);
-
-		mutex_unlock(&pool->lock);
-		work->work(work->cookie);
+		iv_work_thread_run_item(pool);
 		iv_invalidate_now();
-		mutex_lock(&pool->lock);
-
-		if (iv_list_empty(&pool->work_done))
-			iv_event_post(&pool->ev);
-		iv_list_add_tail(&work->list, &pool->work_done);
 	}
 
-	if (pool->seq_head == pool->seq_tail) {
+	if (iv_work_queue_empty(pool)) {
 		if (!pool->shutting_down) {
 			iv_list_add(&thr->list, &pool->idle_threads);
-			iv_validate_now();
-			thr->idle_timer.expires = iv_now;
-			thr->idle_timer.expires.tv_sec += 10;
-			iv_timer_register(&thr->idle_timer);
+			iv_work_thread_arm_idle_timer(thr);
 		} else {
 			__iv_work_thread_die(thr);
 		}
@@ -156,11 +525,9 @@ static void iv_work_thread_idle_timeout(void *_thr)
 	struct work_pool_priv *pool = thr->pool;
 
 	mutex_lock(&pool->lock);
-	
-	if (thr->kicked) {
-		thr->idle_timer.expires = iv_now;
-		thr->idle_timer.expires.tv_sec += 10;
-		iv_timer_register(&thr->idle_timer);
+
+	if (thr->kicked || pool->started_threads <= pool->min_threads) {
+		iv_work_thread_arm_idle_timer(thr);
 	} else {
 		iv_list_del_init(&thr->list);
 		__iv_work_thread_die(thr);
@@ -202,44 +569,197 @@ static void iv_work_thread(void *_thr)
 	iv_deinit();
 }
 
+static void iv_work_thread_lightweight(void *_thr)
+{
+	struct work_pool_thread *thr = _thr;
+	struct work_pool_priv *pool = thr->pool;
+	int last;
+
+	if (pool->thread_start != NULL)
+		pool->thread_start(pool->cookie);
+
+	mutex_lock(&pool->lock);
+
+	while (1) {
+		while ((int32_t)(pool->seq_tail - pool->seq_head) > 0)
+			iv_work_thread_run_item(pool);
+
+		if (pool->shutting_down)
+			break;
+
+		/*
+		 * As with the idle timer of regular pool threads,
+		 * only decide whether to exit once the idle timeout
+		 * has passed, as the pool may have grown beyond its
+		 * minimum size in the meantime.
+		 */
+		iv_list_add(&thr->list, &pool->idle_threads);
+		while (!thr->kicked) {
+			if (cond_timedwait(&thr->cond, &pool->lock,
+					   pool->idle_timeout) &&
+			    pool->started_threads > pool->min_threads)
+				break;
+		}
+		iv_list_del_init(&thr->list);
+
+		if (!thr->kicked)
+			break;
+		thr->kicked = 0;
+	}
+
+	__iv_work_thread_die(thr);
+
+	/*
+	 * Shared pools have no owner thread to clean up after them,
+	 * so the last thread to exit after the pool was put frees it,
+	 * unless there are completions left to deliver, in which case
+	 * the last of those frees it.
+	 */
+	last = pool->shared && pool->shutting_down &&
+	       !pool->started_threads && !pool->refs;
+
+	mutex_unlock(&pool->lock);
+
+	if (last)
+		iv_work_pool_free(pool);
+}
+
+static void iv_work_thread_kick(struct work_pool_thread *thr)
+{
+	struct work_pool_priv *pool = thr->pool;
+
+	thr->kicked = 1;
+	if (!pool->lightweight)
+		iv_event_post(&thr->kick);
+	else
+		cond_signal(&thr->cond);
+}
+
 
 /* main thread **************************************************************/
+#define COMPLETION_BATCH	64
+
+static int
+iv_work_complete_batch(struct work_pool_priv *pool, struct iv_list_head *items,
+		       int max)
+{
+	struct iv_work_item *batch[COMPLETION_BATCH];
+	int num;
+
+	if (max > COMPLETION_BATCH)
+		max = COMPLETION_BATCH;
+
+	num = 0;
+	while (num < max && !iv_list_empty(items)) {
+		struct iv_work_item *work;
+
+		work = iv_container_of(items->next, struct iv_work_item, list);
+
+		/*
+		 * Group completions are internal work items, and are
+		 * never handed to ->completion_batch.
+		 */
+		if (iv_work_item_is_group(work)) {
+			if (num)
+				break;
+
+			iv_list_del(&work->list);
+			work->completion(work->cookie);
+
+			return 1;
+		}
+
+		iv_list_del(&work->list);
+
+		batch[num++] = work;
+	}
+
+	pool->completion_batch(pool->cookie, batch, num);
+
+	return num;
+}
+
 static void iv_work_event(void *_pool)
 {
 	struct work_pool_priv *pool = _pool;
 	struct iv_list_head items;
+	int space_ready;
+	int budget;
 
 	mutex_lock(&pool->lock);
 	__iv_list_steal_elements(&pool->work_done, &items);
+	space_ready = pool->space_ready;
+	pool->space_ready = 0;
 	mutex_unlock(&pool->lock);
 
-	while (!iv_list_empty(&items)) {
+	if (space_ready)
+		pool->space_available(pool->cookie);
+
+	budget = pool->max_completions ? : -1;
+	while (!iv_list_empty(&items) && budget) {
 		struct iv_work_item *work;
 
+		if (pool->completion_batch != NULL) {
+			int num;
+
+			num = iv_work_complete_batch(pool, &items,
+				budget > 0 ? budget : COMPLETION_BATCH);
+			if (budget > 0)
+				budget -= num;
+			continue;
+		}
+
 		work = iv_container_of(items.next, struct iv_work_item, list);
 		iv_list_del(&work->list);
 
 		work->completion(work->cookie);
+
+		if (budget > 0)
+			budget--;
+	}
+
+	/*
+	 * If we ran out of completion budget, put the remaining
+	 * completed items back at the head of the done list, and
+	 * arrange to get called again after the next poll, so that
+	 * a large burst of completions doesn't starve other event
+	 * sources in this thread.
+	 */
+	if (!iv_list_empty(&items)) {
+		mutex_lock(&pool->lock);
+		iv_list_splice(&items, &pool->work_done);
+		iv_event_post(&pool->ev);
+		mutex_unlock(&pool->lock);
+		return;
 	}
 
 	if (pool->shutting_down) {
 		mutex_lock(&pool->lock);
 		if (!pool->started_threads && iv_list_empty(&pool->work_done)) {
 			mutex_unlock(&pool->lock);
-			mutex_destroy(&pool->lock);
-			iv_event_unregister(&pool->ev);
-			free(pool);
+			iv_work_pool_free(pool);
 			return;
 		}
 		mutex_unlock(&pool->lock);
 	}
 }
 
+static int iv_work_start_thread(struct work_pool_priv *pool);
+static void iv_work_grow_timer_expired(void *_pool);
+
 int iv_work_pool_create(struct iv_work_pool *this)
 {
 	struct work_pool_priv *pool;
 	int ret;
 
+	/*
+	 * Space available notifications are delivered to the thread
+	 * that owns the pool, which shared pools don't have.
+	 */
+	if (this->max_queue_depth && this->shared &&
+	    this->queue_policy == IV_WORK_QUEUE_NOTIFY)
+		return -1;
+
 	pool = malloc(sizeof(*pool));
 	if (pool == NULL)
 		return -1;
@@ -250,24 +770,62 @@ int iv_work_pool_create(struct iv_work_pool *this)
 		return -1;
 	}
 
+	/*
+	 * Shared pools deliver completions to the submitting thread
+	 * rather than to the thread that created the pool, and their
+	 * worker threads don't depend on the creating thread staying
+	 * around, so they don't need a completion event of their own.
+	 */
 	IV_EVENT_INIT(&pool->ev);
 	pool->ev.cookie = pool;
 	pool->ev.handler = iv_work_event;
-	iv_event_register(&pool->ev);
+	if (!this->shared)
+		iv_event_register(&pool->ev);
+
+	IV_TIMER_INIT(&pool->grow_timer);
+	pool->grow_timer.cookie = pool;
+	pool->grow_timer.handler = iv_work_grow_timer_expired;
 
 	pool->shutting_down = 0;
+	pool->max_threads = this->max_threads;
+	pool->min_threads = this->min_threads;
+	if (pool->min_threads > pool->max_threads)
+		pool->min_threads = pool->max_threads;
+	pool->idle_timeout = this->idle_timeout ? : DEFAULT_IDLE_TIMEOUT;
+	pool->max_queue_latency = this->max_queue_latency;
+	pool->max_queue_depth = this->max_queue_depth;
+	pool->queue_policy = this->queue_policy;
+	pool->queue_low_watermark = this->queue_low_watermark;
+	pool->space_wanted = 0;
+	pool->space_ready = 0;
+	pool->lightweight = this->lightweight || this->shared;
+	pool->shared = this->shared;
+	pool->refs = 0;
 	pool->started_threads = 0;
 	INIT_IV_LIST_HEAD(&pool->idle_threads);
 	pool->cookie = this->cookie;
 	pool->thread_start = this->thread_start;
 	pool->thread_stop = this->thread_stop;
-	pool->seq_head = 0;
-	pool->seq_tail = 0;
-	INIT_IV_LIST_HEAD(&pool->work_items);
+	pool->space_available = this->space_available;
+	pool->max_completions = this->max_completions;
+	pool->completion_batch = this->completion_batch;
+	iv_work_queue_init(pool);
 	INIT_IV_LIST_HEAD(&pool->work_done);
 
 	this->priv = pool;
 
+	/*
+	 * Start the pool's minimum number of threads right away, so
+	 * that the first burst of work doesn't have to wait for
+	 * thread creation and event loop initialisation.
+	 */
+	mutex_lock(&pool->lock);
+	while (pool->started_threads < pool->min_threads) {
+		if (iv_work_start_thread(pool) < 0)
+			break;
+	}
+	mutex_unlock(&pool->lock);
+
 	return 0;
 }
 
@@ -282,8 +840,14 @@ void iv_work_pool_put(struct iv_work_pool *this)
 	pool->shutting_down = 1;
 
 	if (!pool->started_threads) {
+		int shared = pool->shared;
+		int refs = pool->refs;
+
 		mutex_unlock(&pool->lock);
-		iv_event_post(&pool->ev);
+		if (!shared)
+			iv_event_post(&pool->ev);
+		else if (!refs)
+			iv_work_pool_free(pool);
 		return;
 	}
 
@@ -291,7 +855,7 @@ void iv_work_pool_put(struct iv_work_pool *this)
 		struct work_pool_thread *thr;
 
 		thr = iv_container_of(ilh, struct work_pool_thread, list);
-		iv_event_post(&thr->kick);
+		iv_work_thread_kick(thr);
 	}
 
 	mutex_unlock(&pool->lock);
@@ -311,7 +875,29 @@ static int iv_work_start_thread(struct work_pool_priv *pool)
 
 	snprintf(name, sizeof(name), "iv_work pool %p thread %p", pool, thr);
 
-	ret = iv_thread_create(name, iv_work_thread, thr);
+	if (!pool->lightweight) {
+		ret = iv_thread_create(name, iv_work_thread, thr);
+	} else {
+		INIT_IV_LIST_HEAD(&thr->list);
+		thr->kicked = 0;
+
+		ret = cond_init(&thr->cond);
+		if (ret) {
+			free(thr);
+			return -1;
+		}
+
+		if (!pool->shared) {
+			ret = iv_thread_create(name,
+					       iv_work_thread_lightweight, thr);
+		} else {
+			ret = iv_thread_create_detached(name,
+					       iv_work_thread_lightweight, thr);
+		}
+		if (ret < 0)
+			cond_destroy(&thr->cond);
+	}
+
 	if (ret < 0) {
 		free(thr);
 		return -1;
@@ -322,36 +908,94 @@ static int iv_work_start_thread(struct work_pool_priv *pool)
 	return 0;
 }
 
-static void
-iv_work_submit_pool(struct iv_work_pool *this, struct iv_work_item *work)
+static void iv_work_check_queue_latency(struct work_pool_priv *pool)
 {
-	struct work_pool_priv *pool = this->priv;
+	struct iv_work_item *oldest;
+	struct timespec expires;
 
-	mutex_lock(&pool->lock);
+	if (iv_work_queue_empty(pool))
+		return;
 
-	pool->seq_tail++;
-	iv_list_add_tail(&work->list, &pool->work_items);
+	if (pool->started_threads >= pool->max_threads)
+		return;
 
-	if (!iv_list_empty(&pool->idle_threads)) {
-		struct work_pool_thread *thr;
+	oldest = iv_work_oldest_item(pool, 0);
 
-		thr = iv_container_of(pool->idle_threads.next,
-				      struct work_pool_thread, list);
-		thr->kicked = 1;
-		iv_event_post(&thr->kick);
-	} else if (pool->started_threads < this->max_threads) {
+	expires = oldest->submitted;
+	timespec_add_ms(&expires, pool->max_queue_latency);
+
+	iv_validate_now();
+	if (!timespec_gt(&expires, &iv_now)) {
 		iv_work_start_thread(pool);
+
+		expires = iv_now;
+		timespec_add_ms(&expires, pool->max_queue_latency);
+	}
+
+	/*
+	 * Shared pools have no thread to run the grow timer in, and
+	 * only reevaluate queue latency when new work is submitted.
+	 */
+	if (!pool->shared && !iv_timer_registered(&pool->grow_timer)) {
+		pool->grow_timer.expires = expires;
+		iv_timer_register(&pool->grow_timer);
 	}
+}
 
+static void iv_work_grow_timer_expired(void *_pool)
+{
+	struct work_pool_priv *pool = _pool;
+
+	mutex_lock(&pool->lock);
+	iv_work_check_queue_latency(pool);
 	mutex_unlock(&pool->lock);
 }
 
-struct iv_work_thr_info {
-	struct iv_task		task;
-	struct iv_list_head	work_items;
-};
+static void iv_work_wake_threads(struct work_pool_priv *pool, int num)
+{
+	struct iv_list_head *ilh;
+
+	/*
+	 * Kick one idle thread per new work item.  Idle threads that
+	 * were already kicked but haven't picked up work yet will
+	 * do so soon, so count those against the new work as well.
+	 */
+	iv_list_for_each (ilh, &pool->idle_threads) {
+		struct work_pool_thread *thr;
+
+		if (!num)
+			return;
+
+		thr = iv_container_of(ilh, struct work_pool_thread, list);
+		if (!thr->kicked)
+			iv_work_thread_kick(thr);
+
+		num--;
+	}
+
+	if (!num)
+		return;
+
+	/*
+	 * If the pool is configured with a queue latency target and
+	 * there are threads running already, only start a new thread
+	 * once the oldest queued work item has been waiting for
+	 * longer than that target, rather than for every work item
+	 * that can't be handed to an idle thread right away.
+	 */
+	if (pool->max_queue_latency && pool->started_threads) {
+		iv_work_check_queue_latency(pool);
+		return;
+	}
+
+	while (num-- && pool->started_threads < pool->max_threads) {
+		if (iv_work_start_thread(pool) < 0)
+			break;
+	}
+}
 
 static void iv_work_handle_local(void *_tinfo);
+static void iv_work_handle_shared(void *_tinfo);
 
 static void iv_work_tls_init_thread(void *_tinfo)
 {
@@ -362,11 +1006,26 @@ static void iv_work_tls_init_thread(void *_tinfo)
 	tinfo->task.handler = iv_work_handle_local;
 
 	INIT_IV_LIST_HEAD(&tinfo->work_items);
+
+	tinfo->shared_items = 0;
+	IV_EVENT_INIT(&tinfo->shared_ev);
+	tinfo->shared_ev.cookie = tinfo;
+	tinfo->shared_ev.handler = iv_work_handle_shared;
+	mutex_init(&tinfo->shared_lock);
+	INIT_IV_LIST_HEAD(&tinfo->shared_done);
+}
+
+static void iv_work_tls_deinit_thread(void *_tinfo)
+{
+	struct iv_work_thr_info *tinfo = _tinfo;
+
+	mutex_destroy(&tinfo->shared_lock);
 }
 
 static struct iv_tls_user iv_work_tls_user = {
 	.sizeof_state	= sizeof(struct iv_work_thr_info),
 	.init_thread	= iv_work_tls_init_thread,
+	.deinit_thread	= iv_work_tls_deinit_thread,
 };
 
 static void iv_work_tls_init(void) __attribute__((constructor));
@@ -387,26 +1046,491 @@ static void iv_work_handle_local(void *_tinfo)
 		work = iv_container_of(items.next, struct iv_work_item, list);
 		iv_list_del(&work->list);
 
-		work->work(work->cookie);
+		if (iv_work_item_may_expire(work)) {
+			iv_validate_now();
+			if (!timespec_gt(&work->deadline, &iv_now))
+				work->status = IV_WORK_STATUS_EXPIRED;
+		}
+
+		if (work->status != IV_WORK_STATUS_EXPIRED)
+			work->work(work->cookie);
+
+		if (work->group == NULL) {
+			work->completion(work->cookie);
+		} else {
+			struct iv_work_group *group = work->group;
+
+			if (!--group->pending)
+				iv_work_group_complete(group);
+		}
+	}
+}
+
+static void iv_work_handle_shared(void *_tinfo)
+{
+	struct iv_work_thr_info *tinfo = _tinfo;
+	struct iv_list_head items;
+	int num;
+
+	mutex_lock(&tinfo->shared_lock);
+	__iv_list_steal_elements(&tinfo->shared_done, &items);
+	mutex_unlock(&tinfo->shared_lock);
+
+	/*
+	 * Only drop our count of outstanding shared work items once
+	 * all completions have been run, so that a completion handler
+	 * that submits new work doesn't try to register our event
+	 * while it is still registered.
+	 */
+	num = 0;
+	while (!iv_list_empty(&items)) {
+		struct iv_work_item *work;
+		struct work_pool_priv *pool;
+
+		work = iv_container_of(items.next, struct iv_work_item, list);
+		iv_list_del(&work->list);
+
+		/*
+		 * The completion handler may free or resubmit the
+		 * work item, so drop the pool reference that it held
+		 * via a copy of its pool pointer.
+		 */
+		pool = work->pool;
 		work->completion(work->cookie);
+		iv_work_pool_unref(pool);
+		num++;
+	}
+
+	tinfo->shared_items -= num;
+	if (!tinfo->shared_items)
+		iv_event_unregister(&tinfo->shared_ev);
+}
+
+/*
+ * Work items submitted to a shared pool remember which thread they
+ * were submitted from, and that thread keeps a completion event
+ * registered for as long as it has shared work items outstanding.
+ * Each such work item also holds a reference on the pool until its
+ * completion has been delivered, so that the pool stays around for
+ * iv_work_pool_cancel() to look at for as long as it may be called.
+ * Must be called with the pool lock held.
+ */
+static void
+iv_work_shared_get(struct work_pool_priv *pool, struct iv_work_item *work)
+{
+	struct iv_work_thr_info *tinfo = iv_tls_user_ptr(&iv_work_tls_user);
+
+	if (!tinfo->shared_items++)
+		iv_event_register(&tinfo->shared_ev);
+
+	pool->refs++;
+	work->owner = tinfo;
+}
+
+static void iv_work_shared_put(struct iv_work_thr_info *tinfo)
+{
+	if (!--tinfo->shared_items)
+		iv_event_unregister(&tinfo->shared_ev);
+}
+
+static int iv_work_pool_stamps_items(struct work_pool_priv *pool)
+{
+	return pool->max_queue_latency ||
+	       (pool->max_queue_depth &&
+		pool->queue_policy == IV_WORK_QUEUE_DROP_OLDEST);
+}
+
+/*
+ * Checks whether there is room in the queue for a new work item,
+ * making room if the pool's queue policy allows for that.  Work
+ * items that are part of a group are never dropped, so if nothing
+ * else is queued, a DROP_OLDEST pool rejects the new work item.
+ */
+static int iv_work_queue_admit(struct work_pool_priv *pool)
+{
+	struct iv_work_item *oldest;
+
+	if (!pool->max_queue_depth ||
+	    iv_work_queue_depth(pool) < pool->max_queue_depth)
+		return 1;
+
+	switch (pool->queue_policy) {
+	case IV_WORK_QUEUE_DROP_OLDEST:
+		oldest = iv_work_oldest_item(pool, 1);
+		if (oldest == NULL)
+			return 0;
+
+		iv_work_unqueue_item(pool, oldest);
+		iv_work_item_not_run(pool, oldest, IV_WORK_STATUS_DROPPED);
+		return 1;
+
+	case IV_WORK_QUEUE_NOTIFY:
+		pool->space_wanted = 1;
+		return 0;
+	}
+
+	return 0;
+}
+
+static int iv_work_submit_pool(struct iv_work_pool *this,
+			       struct iv_work_item *work,
+			       struct iv_work_group *group)
+{
+	struct work_pool_priv *pool = this->priv;
+
+	if (iv_work_pool_stamps_items(pool)) {
+		iv_validate_now();
+		work->submitted = iv_now;
+	}
+
+	mutex_lock(&pool->lock);
+
+	/*
+	 * Work items forked off as part of a group aren't subject to
+	 * the queue depth limit, as groups have no way of backing off.
+	 */
+	if (group == NULL && !iv_work_queue_admit(pool)) {
+		mutex_unlock(&pool->lock);
+		return -1;
+	}
+
+	if (pool->shared && group == NULL)
+		iv_work_shared_get(pool, work);
+
+	work->group = group;
+	if (group != NULL)
+		group->pending++;
+
+	pool->max_threads = this->max_threads;
+
+	work->status = IV_WORK_STATUS_DONE;
+	iv_work_queue_item(pool, work);
+
+	iv_work_wake_threads(pool, 1);
+
+	mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+static int iv_work_submit_pool_batch(struct iv_work_pool *this,
+				     struct iv_work_item **items, int num_items)
+{
+	struct work_pool_priv *pool = this->priv;
+	int i;
+
+	if (iv_work_pool_stamps_items(pool)) {
+		iv_validate_now();
+		for (i = 0; i < num_items; i++)
+			items[i]->submitted = iv_now;
+	}
+
+	mutex_lock(&pool->lock);
+
+	pool->max_threads = this->max_threads;
+
+	for (i = 0; i < num_items; i++) {
+		if (!iv_work_queue_admit(pool))
+			break;
+
+		if (pool->shared)
+			iv_work_shared_get(pool, items[i]);
+
+		items[i]->group = NULL;
+		items[i]->status = IV_WORK_STATUS_DONE;
+		iv_work_queue_item(pool, items[i]);
 	}
+
+	iv_work_wake_threads(pool, i);
+
+	mutex_unlock(&pool->lock);
+
+	return i;
 }
 
-static void iv_work_submit_local(struct iv_work_item *work)
+static void iv_work_submit_local(struct iv_work_item *work,
+				 struct iv_work_group *group)
 {
 	struct iv_work_thr_info *tinfo = iv_tls_user_ptr(&iv_work_tls_user);
 
+	work->status = IV_WORK_STATUS_DONE;
+	work->pool = NULL;
+	work->group = group;
+
+	if (group != NULL)
+		group->pending++;
+
 	if (iv_list_empty(&tinfo->work_items))
 		iv_task_register(&tinfo->task);
 
 	iv_list_add_tail(&work->list, &tinfo->work_items);
 }
 
-void
+int
 iv_work_pool_submit_work(struct iv_work_pool *this, struct iv_work_item *work)
 {
 	if (this != NULL)
-		iv_work_submit_pool(this, work);
+		return iv_work_submit_pool(this, work, NULL);
+
+	iv_work_submit_local(work, NULL);
+
+	return 0;
+}
+
+int iv_work_pool_submit_batch(struct iv_work_pool *this,
+			      struct iv_work_item **items, int num_items)
+{
+	int i;
+
+	if (this != NULL)
+		return iv_work_submit_pool_batch(this, items, num_items);
+
+	for (i = 0; i < num_items; i++)
+		iv_work_submit_local(items[i], NULL);
+
+	return num_items;
+}
+
+int iv_work_pool_cancel(struct iv_work_item *work, int flags)
+{
+	struct work_pool_priv *pool = work->pool;
+	int shared;
+
+	/*
+	 * ->pool is only ever written by the thread that submitted
+	 * the work item, which is also the only thread that may call
+	 * us, so we can read it without holding any lock.  The pool
+	 * is guaranteed to still be around until the item's (or its
+	 * group's) completion has been delivered: for shared pools
+	 * because the item holds a reference on the pool until then,
+	 * and for other pools because they are only freed from this
+	 * thread once all completions have been delivered.  Whether
+	 * the item is still queued is only known under the pool lock.
+	 */
+	if (pool == NULL)
+		return -1;
+
+	mutex_lock(&pool->lock);
+
+	if (!work->queued) {
+		mutex_unlock(&pool->lock);
+		return -1;
+	}
+
+	iv_work_unqueue_item(pool, work);
+
+	/*
+	 * Canceling a work item that is part of a group counts as
+	 * that item having run, as far as the group is concerned.
+	 */
+	if (work->group != NULL) {
+		iv_work_item_not_run(pool, work, IV_WORK_STATUS_CANCELLED);
+		mutex_unlock(&pool->lock);
+		return 0;
+	}
+
+	shared = pool->shared;
+	if (!(flags & IV_WORK_CANCEL_FLAG_SILENT))
+		iv_work_item_not_run(pool, work, IV_WORK_STATUS_CANCELLED);
+
+	mutex_unlock(&pool->lock);
+
+	if (shared && (flags & IV_WORK_CANCEL_FLAG_SILENT)) {
+		iv_work_shared_put(work->owner);
+		iv_work_pool_unref(pool);
+	}
+
+	return 0;
+}
+
+
+/* fork/join groups *********************************************************/
+struct iv_work_range {
+	__mutex_t		lock;
+	int			next;
+	int			end;
+	int			grain;
+	void			(*fn)(void *cookie, int begin, int end);
+	void			*cookie;
+	struct iv_work_item	items[0];
+};
+
+static void iv_work_group_complete(void *_group)
+{
+	struct iv_work_group *group = _group;
+	struct iv_work_range *range = group->range;
+
+	if (range != NULL) {
+		group->range = NULL;
+		mutex_destroy(&range->lock);
+		free(range);
+	}
+
+	group->completion(group->cookie);
+}
+
+static void iv_work_group_nop(void *_group)
+{
+}
+
+static void
+iv_work_group_start(struct iv_work_group *group, struct work_pool_priv *pool)
+{
+	group->pool = pool;
+	group->forked = 1;
+
+	IV_WORK_ITEM_INIT(&group->done);
+	group->done.cookie = group;
+	group->done.work = iv_work_group_nop;
+	group->done.completion = iv_work_group_complete;
+	group->done.pool = pool;
+
+	if (pool != NULL && pool->shared) {
+		mutex_lock(&pool->lock);
+		iv_work_shared_get(pool, &group->done);
+		mutex_unlock(&pool->lock);
+	}
+}
+
+void iv_work_group_fork(struct iv_work_pool *this, struct iv_work_group *group,
+			struct iv_work_item *work)
+{
+	struct work_pool_priv *pool = (this != NULL) ? this->priv : NULL;
+
+	if (group->joined)
+		iv_fatal("iv_work_group_fork: called on joined group");
+
+	if (!group->forked)
+		iv_work_group_start(group, pool);
+	else if (group->pool != pool)
+		iv_fatal("iv_work_group_fork: group spans multiple pools");
+
+	if (this != NULL)
+		iv_work_submit_pool(this, work, group);
 	else
-		iv_work_submit_local(work);
+		iv_work_submit_local(work, group);
+}
+
+void iv_work_group_join(struct iv_work_group *group)
+{
+	struct work_pool_priv *pool = group->pool;
+
+	if (group->joined)
+		iv_fatal("iv_work_group_join: called on joined group");
+
+	if (!group->forked)
+		iv_work_group_start(group, NULL);
+
+	group->joined = 1;
+
+	/*
+	 * A group starts out with a pending count of one, which
+	 * represents the group not having been joined yet, so that
+	 * the group completion can't fire while work items are still
+	 * being forked off.
+	 */
+	if (pool == NULL) {
+		if (!--group->pending)
+			iv_work_submit_local(&group->done, NULL);
+		return;
+	}
+
+	mutex_lock(&pool->lock);
+	if (!--group->pending)
+		iv_work_complete_item(pool, &group->done);
+	mutex_unlock(&pool->lock);
+}
+
+/*
+ * Rather than submitting one work item per chunk, submit one work
+ * item per pool thread that could usefully work on the range, and
+ * have each of those work items keep claiming the next chunk of the
+ * range until there are no chunks left, so that threads that happen
+ * to get through their chunks quickly pick up the slack for others.
+ */
+static void iv_work_range_work(void *_range)
+{
+	struct iv_work_range *range = _range;
+
+	while (1) {
+		int begin;
+		int end;
+
+		mutex_lock(&range->lock);
+		begin = range->next;
+		if (begin >= range->end) {
+			mutex_unlock(&range->lock);
+			break;
+		}
+		if (range->end - begin > range->grain)
+			end = begin + range->grain;
+		else
+			end = range->end;
+		range->next = end;
+		mutex_unlock(&range->lock);
+
+		range->fn(range->cookie, begin, end);
+	}
+}
+
+int iv_work_parallel_for(struct iv_work_pool *this,
+			 struct iv_work_group *group, int begin, int end,
+			 int grain, void (*fn)(void *cookie, int begin, int end))
+{
+	struct iv_work_range *range;
+	int num_chunks;
+	int num_items;
+	int i;
+
+	/*
+	 * The group is joined below, so it can't be used for another
+	 * range until its completion has been reported and it has
+	 * been reinitialised, as that would lose the earlier range.
+	 */
+	if (group->joined || group->range != NULL)
+		return -1;
+
+	if (grain < 1)
+		grain = 1;
+
+	num_chunks = 0;
+	if (end > begin)
+		num_chunks = ((end - begin) - 1) / grain + 1;
+
+	num_items = 1;
+	if (this != NULL && this->max_threads > 1)
+		num_items = this->max_threads;
+	if (num_items > num_chunks)
+		num_items = num_chunks;
+
+	range = malloc(sizeof(*range) + num_items * sizeof(range->items[0]));
+	if (range == NULL)
+		return -1;
+
+	if (mutex_init(&range->lock)) {
+		free(range);
+		return -1;
+	}
+
+	range->next = begin;
+	range->end = end;
+	range->grain = grain;
+	range->fn = fn;
+	range->cookie = group->cookie;
+
+	group->range = range;
+
+	for (i = 0; i < num_items; i++) {
+		struct iv_work_item *work = &range->items[i];
+
+		IV_WORK_ITEM_INIT(work);
+		work->cookie = range;
+		work->work = iv_work_range_work;
+		work->completion = NULL;
+		iv_work_group_fork(this, group, work);
+	}
+
+	iv_work_group_join(group);
+
+	return 0;
 }
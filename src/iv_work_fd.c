@@ -0,0 +1,103 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iv.h>
+#include <iv_work.h>
+
+/*
+ * The fd is registered as a oneshot fd in the registering thread,
+ * and each time it becomes ready, its handler is submitted to the
+ * pool as a work item.  The fd is only re-armed from the work item's
+ * completion callback, which runs back in the registering thread,
+ * so that the handler never runs in more than one thread at once.
+ */
+static void iv_work_fd_work(void *_wfd)
+{
+	struct iv_work_fd *wfd = _wfd;
+
+	wfd->handler(wfd->cookie, wfd->ready_bands);
+}
+
+static void iv_work_fd_done(void *_wfd)
+{
+	struct iv_work_fd *wfd = _wfd;
+
+	wfd->running = 0;
+
+	if (iv_fd_registered(&wfd->ivfd))
+		iv_fd_rearm(&wfd->ivfd);
+
+	if (wfd->completion != NULL)
+		wfd->completion(wfd->cookie);
+}
+
+static void iv_work_fd_ready(void *_wfd, int bands)
+{
+	struct iv_work_fd *wfd = _wfd;
+
+	wfd->ready_bands = bands;
+	wfd->running = 1;
+
+	IV_WORK_ITEM_INIT(&wfd->work);
+	wfd->work.cookie = wfd;
+	wfd->work.work = iv_work_fd_work;
+	wfd->work.completion = iv_work_fd_done;
+
+	/*
+	 * If the pool's queue is full, run the handler locally
+	 * instead of dropping the event on the floor.
+	 */
+	if (iv_work_pool_submit_work(wfd->pool, &wfd->work) < 0)
+		iv_work_pool_submit_work(NULL, &wfd->work);
+}
+
+void iv_work_fd_register(struct iv_work_pool *this, struct iv_work_fd *wfd)
+{
+	if (wfd->running) {
+		iv_fatal("iv_work_fd_register: called with fd whose "
+			 "handler is still running");
+	}
+
+	wfd->pool = this;
+
+	IV_FD_INIT(&wfd->ivfd);
+	wfd->ivfd.fd = wfd->fd;
+	wfd->ivfd.cookie = wfd;
+	iv_fd_set_handler(&wfd->ivfd, iv_work_fd_ready, wfd->bands);
+	iv_fd_set_oneshot(&wfd->ivfd, 1);
+	iv_fd_register(&wfd->ivfd);
+}
+
+int iv_work_fd_unregister(struct iv_work_fd *wfd)
+{
+	iv_fd_unregister(&wfd->ivfd);
+
+	/*
+	 * A handler that hasn't started running yet can be
+	 * canceled, but one that is already running can't, and
+	 * its completion will then still be called.
+	 */
+	if (wfd->running &&
+	    !iv_work_pool_cancel(&wfd->work, IV_WORK_CANCEL_FLAG_SILENT))
+		wfd->running = 0;
+
+	return wfd->running;
+}
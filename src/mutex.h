@@ -18,8 +18,13 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include "config.h"
+
 #ifndef _WIN32
+#include <errno.h>
 #include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
 
 typedef pthread_mutex_t __mutex_t;
 
@@ -42,6 +47,52 @@ static inline void mutex_unlock(__mutex_t *mutex)
 {
 	pthread_mutex_unlock(mutex);
 }
+
+typedef pthread_cond_t __cond_t;
+
+static inline int cond_init(__cond_t *cond)
+{
+	return pthread_cond_init(cond, NULL);
+}
+
+static inline void cond_destroy(__cond_t *cond)
+{
+	pthread_cond_destroy(cond);
+}
+
+static inline void cond_signal(__cond_t *cond)
+{
+	pthread_cond_signal(cond);
+}
+
+static inline void cond_wait(__cond_t *cond, __mutex_t *mutex)
+{
+	pthread_cond_wait(cond, mutex);
+}
+
+static inline int cond_timedwait(__cond_t *cond, __mutex_t *mutex, int msec)
+{
+	struct timespec abstime;
+
+#ifdef HAVE_CLOCK_REALTIME
+	clock_gettime(CLOCK_REALTIME, &abstime);
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	abstime.tv_sec = tv.tv_sec;
+	abstime.tv_nsec = 1000 * tv.tv_usec;
+#endif
+
+	abstime.tv_sec += msec / 1000;
+	abstime.tv_nsec += 1000000 * (msec % 1000);
+	if (abstime.tv_nsec >= 1000000000) {
+		abstime.tv_sec++;
+		abstime.tv_nsec -= 1000000000;
+	}
+
+	return pthread_cond_timedwait(cond, mutex, &abstime) == ETIMEDOUT;
+}
 #else
 typedef CRITICAL_SECTION __mutex_t;
 
@@ -66,4 +117,32 @@ static inline void mutex_unlock(__mutex_t *mutex)
 {
 	LeaveCriticalSection(mutex);
 }
+
+typedef CONDITION_VARIABLE __cond_t;
+
+static inline int cond_init(__cond_t *cond)
+{
+	InitializeConditionVariable(cond);
+
+	return 0;
+}
+
+static inline void cond_destroy(__cond_t *cond)
+{
+}
+
+static inline void cond_signal(__cond_t *cond)
+{
+	WakeConditionVariable(cond);
+}
+
+static inline void cond_wait(__cond_t *cond, __mutex_t *mutex)
+{
+	SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+static inline int cond_timedwait(__cond_t *cond, __mutex_t *mutex, int msec)
+{
+	return !SleepConditionVariableCS(cond, mutex, msec);
+}
 #endif
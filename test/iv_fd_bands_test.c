@@ -0,0 +1,153 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <iv.h>
+
+static struct iv_fd fd;
+static int step;
+
+static void got_event(void *cookie, int bands)
+{
+	if (step == 0 && bands == IV_FD_BAND_RDHUP) {
+		step = 1;
+		iv_fd_unregister(&fd);
+	} else if (step == 2 && bands == IV_FD_BAND_PRI) {
+		step = 3;
+		iv_fd_unregister(&fd);
+	} else {
+		fprintf(stderr, "got bands %x in step %d\n", bands, step);
+		exit(1);
+	}
+}
+
+static void test_rdhup(void)
+{
+	int sfd[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sfd) < 0) {
+		perror("socketpair");
+		exit(1);
+	}
+
+	IV_FD_INIT(&fd);
+	fd.fd = sfd[0];
+	iv_fd_set_handler(&fd, got_event, IV_FD_BAND_RDHUP);
+	iv_fd_register(&fd);
+
+	/*
+	 * A half-close by the peer should be reported without the
+	 * read side being involved.
+	 */
+#ifdef __linux__
+	shutdown(sfd[1], SHUT_WR);
+#else
+	close(sfd[1]);
+#endif
+
+	iv_main();
+
+	if (step != 1) {
+		fprintf(stderr, "no half-close reported\n");
+		exit(1);
+	}
+
+	close(sfd[0]);
+}
+
+static void test_pri(void)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	int lfd;
+	int cfd;
+	int afd;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	addrlen = sizeof(addr);
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &addrlen) < 0 ||
+	    listen(lfd, 1) < 0) {
+		perror("bind");
+		exit(1);
+	}
+
+	cfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (cfd < 0 ||
+	    connect(cfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("connect");
+		exit(1);
+	}
+
+	afd = accept(lfd, NULL, NULL);
+	if (afd < 0) {
+		perror("accept");
+		exit(1);
+	}
+
+	step = 2;
+
+	IV_FD_INIT(&fd);
+	fd.fd = afd;
+	iv_fd_set_handler(&fd, got_event, IV_FD_BAND_PRI);
+	iv_fd_register(&fd);
+
+	if (send(cfd, "!", 1, MSG_OOB) != 1) {
+		perror("send");
+		exit(1);
+	}
+
+	iv_main();
+
+	if (step != 3) {
+		fprintf(stderr, "no urgent data reported\n");
+		exit(1);
+	}
+
+	close(afd);
+	close(cfd);
+	close(lfd);
+}
+
+int main()
+{
+	iv_init();
+
+	test_rdhup();
+	test_pri();
+
+	iv_deinit();
+
+	return 0;
+}
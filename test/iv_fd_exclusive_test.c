@@ -0,0 +1,264 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <iv.h>
+#include <iv_event.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#define NUM_THREADS	4
+#define NUM_CONNS	50
+
+static int lfd;
+
+static struct thr {
+	pthread_t		thread;
+	struct iv_fd		fd;
+	struct iv_event		ev;
+} thr[NUM_THREADS];
+
+static volatile int registered;
+static volatile int accepted;
+static volatile int spurious;
+static const char *method;
+
+static void got_err(void *_t)
+{
+	fprintf(stderr, "error on listening socket\n");
+	exit(1);
+}
+
+static void got_conn(void *_t)
+{
+	struct thr *t = _t;
+	int fd;
+
+	/*
+	 * Changing the set of handlers of an exclusive fd that is
+	 * already registered with the kernel needs special care
+	 * with EPOLLEXCLUSIVE, so exercise that as well.
+	 */
+	if (t->fd.handler_err == NULL)
+		iv_fd_set_handler_err(&t->fd, got_err);
+
+	fd = accept(lfd, NULL, NULL);
+	if (fd < 0) {
+		if (errno != EAGAIN) {
+			perror("accept");
+			exit(1);
+		}
+		__sync_fetch_and_add(&spurious, 1);
+		return;
+	}
+
+	close(fd);
+	__sync_fetch_and_add(&accepted, 1);
+}
+
+static void got_quit(void *_t)
+{
+	struct thr *t = _t;
+
+	iv_fd_unregister(&t->fd);
+	iv_event_unregister(&t->ev);
+}
+
+static void *thr_main(void *_t)
+{
+	struct thr *t = _t;
+
+	iv_init();
+
+	IV_FD_INIT(&t->fd);
+	t->fd.fd = lfd;
+	t->fd.cookie = t;
+	t->fd.handler_in = got_conn;
+	iv_fd_set_exclusive(&t->fd, 1);
+	iv_fd_register(&t->fd);
+
+	IV_EVENT_INIT(&t->ev);
+	t->ev.cookie = t;
+	t->ev.handler = got_quit;
+	iv_event_register(&t->ev);
+
+	method = iv_poll_method_name();
+	__sync_fetch_and_add(&registered, 1);
+
+	iv_main();
+
+	iv_deinit();
+
+	return NULL;
+}
+
+static void got_bands(void *_t, int bands)
+{
+}
+
+static void fatal_exit(const char *msg)
+{
+	_exit(2);
+}
+
+/*
+ * Exclusive wakeups can't be combined with watching for RDHUP or
+ * PRI, and asking for that combination in either order must fail
+ * cleanly rather than when the fd is handed to the kernel.
+ */
+static int rejects_rdhup(int exclusive_first)
+{
+	pid_t pid;
+	int status;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		exit(1);
+	}
+
+	if (pid == 0) {
+		struct iv_fd fd;
+
+		iv_set_fatal_msg_handler(fatal_exit);
+		iv_init();
+
+		IV_FD_INIT(&fd);
+		fd.fd = lfd;
+		if (exclusive_first) {
+			iv_fd_set_exclusive(&fd, 1);
+			iv_fd_set_handler(&fd, got_bands,
+					  IV_FD_BAND_IN | IV_FD_BAND_RDHUP);
+		} else {
+			iv_fd_set_handler(&fd, got_bands,
+					  IV_FD_BAND_IN | IV_FD_BAND_PRI);
+			iv_fd_set_exclusive(&fd, 1);
+		}
+
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		exit(1);
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 2;
+}
+
+int main()
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	int i;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	addrlen = sizeof(addr);
+	if (getsockname(lfd, (struct sockaddr *)&addr, &addrlen) < 0) {
+		perror("getsockname");
+		return 1;
+	}
+
+	if (listen(lfd, NUM_CONNS) < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	if (!rejects_rdhup(1) || !rejects_rdhup(0)) {
+		fprintf(stderr, "exclusive fd accepted RDHUP or PRI\n");
+		return 1;
+	}
+
+	for (i = 0; i < NUM_THREADS; i++)
+		pthread_create(&thr[i].thread, NULL, thr_main, &thr[i]);
+
+	while (registered < NUM_THREADS)
+		usleep(1000);
+
+	/*
+	 * Give the threads a chance to go to sleep in the kernel.
+	 */
+	usleep(10000);
+
+	for (i = 0; i < NUM_CONNS; i++) {
+		int fd;
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) {
+			perror("socket");
+			return 1;
+		}
+
+		if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			perror("connect");
+			return 1;
+		}
+
+		while (accepted < i + 1)
+			usleep(100);
+
+		close(fd);
+	}
+
+	for (i = 0; i < NUM_THREADS; i++)
+		iv_event_post(&thr[i].ev);
+
+	for (i = 0; i < NUM_THREADS; i++)
+		pthread_join(thr[i].thread, NULL);
+
+	printf("%s: %d connections, %d spurious wakeups\n",
+	       method, accepted, spurious);
+
+#ifdef EPOLLEXCLUSIVE
+	/*
+	 * Without exclusive wakeups, every connection would wake
+	 * up all threads.
+	 */
+	if (!strcmp(method, "epoll") && spurious >= NUM_CONNS) {
+		fprintf(stderr, "too many spurious wakeups\n");
+		return 1;
+	}
+#endif
+
+	return 0;
+}
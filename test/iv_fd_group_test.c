@@ -0,0 +1,232 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iv.h>
+
+#define NUM_FDS		200
+
+struct member {
+	int		wfd;
+	struct iv_fd	fd;
+	int		seen;
+};
+
+static struct iv_fd_group group;
+static struct member members[NUM_FDS];
+static int batches;
+static int seen;
+
+static void member_in(void *cookie)
+{
+	fprintf(stderr, "member fd handler called\n");
+	exit(1);
+}
+
+static void group_ready(void *cookie, struct iv_fd_ready *ready, int num)
+{
+	int i;
+
+	if (cookie != &group) {
+		fprintf(stderr, "group handler called with wrong cookie\n");
+		exit(1);
+	}
+
+	batches++;
+
+	for (i = 0; i < num; i++) {
+		struct member *m = ready[i].cookie;
+
+		if (ready[i].bands != IV_FD_BAND_IN) {
+			fprintf(stderr, "unexpected bands %d\n",
+				ready[i].bands);
+			exit(1);
+		}
+
+		m->seen++;
+		seen++;
+
+		iv_fd_unregister(&m->fd);
+		close(m->fd.fd);
+		close(m->wfd);
+	}
+}
+
+/*
+ * Two oneshot fds in two different groups become ready in the same
+ * loop iteration, and whichever group handler runs first moves the
+ * other fd out of its group while its event is still pending.  That
+ * event must then be delivered to the fd's own handler rather than
+ * be lost.
+ */
+static struct iv_fd_group move_groups[2];
+static struct member move_members[2];
+static int moved_seen;
+
+static void moved_in(void *cookie)
+{
+	struct member *m = cookie;
+	char buf[1];
+
+	if (read(m->fd.fd, buf, 1) != 1) {
+		fprintf(stderr, "moved fd not readable\n");
+		exit(1);
+	}
+
+	m->seen++;
+	moved_seen++;
+	iv_fd_unregister(&m->fd);
+}
+
+static void move_group_ready(void *cookie, struct iv_fd_ready *ready, int num)
+{
+	struct member *m = ready[0].cookie;
+	struct member *other;
+	char buf[1];
+
+	if (num != 1 || read(m->fd.fd, buf, 1) != 1) {
+		fprintf(stderr, "unexpected group event\n");
+		exit(1);
+	}
+
+	m->seen++;
+	iv_fd_unregister(&m->fd);
+
+	other = &move_members[m == &move_members[0]];
+	if (other->seen)
+		return;
+
+	iv_fd_set_group(&other->fd, NULL);
+}
+
+static int test_move(void)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct member *m = &move_members[i];
+		int pfd[2];
+
+		IV_FD_GROUP_INIT(&move_groups[i]);
+		move_groups[i].handler = move_group_ready;
+
+		if (pipe(pfd) < 0) {
+			perror("pipe");
+			return 1;
+		}
+
+		m->wfd = pfd[1];
+		m->seen = 0;
+
+		IV_FD_INIT(&m->fd);
+		m->fd.fd = pfd[0];
+		m->fd.cookie = m;
+		m->fd.handler_in = moved_in;
+		iv_fd_set_oneshot(&m->fd, 1);
+		iv_fd_set_group(&m->fd, &move_groups[i]);
+		iv_fd_register(&m->fd);
+
+		if (write(m->wfd, "x", 1) != 1) {
+			perror("write");
+			return 1;
+		}
+	}
+
+	iv_main();
+
+	for (i = 0; i < 2; i++) {
+		close(move_members[i].fd.fd);
+		close(move_members[i].wfd);
+
+		if (move_members[i].seen != 1) {
+			fprintf(stderr, "moved fd %d reported %d times\n",
+				i, move_members[i].seen);
+			return 1;
+		}
+	}
+
+	if (moved_seen != 1) {
+		fprintf(stderr, "%d fds reported after moving\n", moved_seen);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	int i;
+
+	alarm(10);
+
+	iv_init();
+
+	if (test_move())
+		return 1;
+
+	IV_FD_GROUP_INIT(&group);
+	group.cookie = &group;
+	group.handler = group_ready;
+
+	for (i = 0; i < NUM_FDS; i++) {
+		struct member *m = &members[i];
+		int pfd[2];
+
+		if (pipe(pfd) < 0) {
+			perror("pipe");
+			return 1;
+		}
+
+		m->wfd = pfd[1];
+		m->seen = 0;
+
+		IV_FD_INIT(&m->fd);
+		m->fd.fd = pfd[0];
+		m->fd.cookie = m;
+		m->fd.handler_in = member_in;
+		iv_fd_set_group(&m->fd, &group);
+		iv_fd_register(&m->fd);
+
+		if (write(m->wfd, "x", 1) != 1) {
+			perror("write");
+			return 1;
+		}
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	for (i = 0; i < NUM_FDS; i++) {
+		if (members[i].seen != 1) {
+			fprintf(stderr, "fd %d reported %d times\n",
+				i, members[i].seen);
+			return 1;
+		}
+	}
+
+	if (batches >= NUM_FDS) {
+		fprintf(stderr, "readiness wasn't batched\n");
+		return 1;
+	}
+
+	return 0;
+}
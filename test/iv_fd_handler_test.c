@@ -0,0 +1,107 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <iv.h>
+
+static int sfd[2];
+static struct iv_fd fd;
+static int calls;
+
+static void got_other(void *cookie)
+{
+	fprintf(stderr, "separate handler called\n");
+	exit(1);
+}
+
+static void got_event(void *cookie, int bands)
+{
+	char buf[16];
+
+	calls++;
+
+	if (cookie != &fd) {
+		fprintf(stderr, "wrong cookie\n");
+		exit(1);
+	}
+
+	if (calls == 1) {
+		/*
+		 * Readable and writable at the same time, which
+		 * should be reported in one call.
+		 */
+		if (bands != (IV_FD_BAND_IN | IV_FD_BAND_OUT)) {
+			fprintf(stderr, "got bands %x\n", bands);
+			exit(1);
+		}
+
+		if (read(sfd[0], buf, sizeof(buf)) != 1) {
+			perror("read");
+			exit(1);
+		}
+
+		iv_fd_set_handler(&fd, got_event, IV_FD_BAND_IN);
+
+		if (write(sfd[1], "x", 1) != 1) {
+			perror("write");
+			exit(1);
+		}
+	} else {
+		if (bands != IV_FD_BAND_IN) {
+			fprintf(stderr, "got bands %x\n", bands);
+			exit(1);
+		}
+
+		iv_fd_unregister(&fd);
+	}
+}
+
+int main()
+{
+	alarm(10);
+
+	iv_init();
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sfd) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	if (write(sfd[1], "x", 1) != 1) {
+		perror("write");
+		return 1;
+	}
+
+	IV_FD_INIT(&fd);
+	fd.fd = sfd[0];
+	fd.cookie = &fd;
+	fd.handler_in = got_other;
+	fd.handler_out = got_other;
+	iv_fd_set_handler(&fd, got_event, IV_FD_BAND_IN | IV_FD_BAND_OUT);
+	iv_fd_register(&fd);
+
+	iv_main();
+
+	iv_deinit();
+
+	return calls == 2 ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <iv.h>
+
+/*
+ * Registers one end of each of a number of socketpairs, spread out
+ * over several event loops.  By default, more fds are used than
+ * fit in a typical default RLIMIT_NOFILE, and the number of pairs
+ * can be given on the command line to test at scale, for example
+ * with a million pairs.
+ */
+#define NUM_LOOPS	4
+#define DEFAULT_PAIRS	16384
+
+static int (*pairs)[2];
+static struct iv_fd *fds;
+
+static struct loop {
+	pthread_t	thread;
+	int		first;
+	int		num;
+	int		fired;
+} loops[NUM_LOOPS];
+
+static void got_data(void *_fd)
+{
+	struct iv_fd *fd = _fd;
+	struct loop *l;
+	char c;
+	int i;
+
+	l = &loops[0];
+	while (fd - fds >= l->first + l->num)
+		l++;
+
+	if (fd - fds != l->first + l->num - 1) {
+		fprintf(stderr, "unexpected fd %d ready\n", (int)(fd - fds));
+		exit(1);
+	}
+
+	if (read(fd->fd, &c, 1) != 1) {
+		perror("read");
+		exit(1);
+	}
+
+	for (i = l->first; i < l->first + l->num; i++)
+		iv_fd_unregister(&fds[i]);
+
+	l->fired = 1;
+}
+
+static void *thr(void *_l)
+{
+	struct loop *l = _l;
+	int i;
+
+	iv_init();
+
+	for (i = l->first; i < l->first + l->num; i++) {
+		IV_FD_INIT(&fds[i]);
+		fds[i].fd = pairs[i][0];
+		fds[i].cookie = &fds[i];
+		fds[i].handler_in = got_data;
+		iv_fd_register(&fds[i]);
+	}
+
+	if (write(pairs[l->first + l->num - 1][1], "x", 1) != 1) {
+		perror("write");
+		exit(1);
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct rlimit lim;
+	int num_pairs;
+	int i;
+
+	num_pairs = (argc > 1) ? atoi(argv[1]) : DEFAULT_PAIRS;
+	if (num_pairs < NUM_LOOPS)
+		num_pairs = NUM_LOOPS;
+
+	iv_init();
+
+	/*
+	 * If we couldn't raise RLIMIT_NOFILE far enough, for example
+	 * because we're not running as root, scale the test down.
+	 */
+	getrlimit(RLIMIT_NOFILE, &lim);
+	if (lim.rlim_cur != RLIM_INFINITY &&
+	    2 * num_pairs + 64 > lim.rlim_cur) {
+		fprintf(stderr, "RLIMIT_NOFILE is %ld, using fewer pairs\n",
+			(long)lim.rlim_cur);
+		num_pairs = (lim.rlim_cur - 64) / 2;
+	}
+
+	pairs = malloc(num_pairs * sizeof(*pairs));
+	fds = malloc(num_pairs * sizeof(*fds));
+	if (pairs == NULL || fds == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < num_pairs; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]) < 0) {
+			perror("socketpair");
+			return 1;
+		}
+	}
+
+	for (i = 0; i < NUM_LOOPS; i++) {
+		loops[i].first = i * (num_pairs / NUM_LOOPS);
+		loops[i].num = num_pairs / NUM_LOOPS;
+		if (i == NUM_LOOPS - 1)
+			loops[i].num = num_pairs - loops[i].first;
+
+		pthread_create(&loops[i].thread, NULL, thr, &loops[i]);
+	}
+
+	for (i = 0; i < NUM_LOOPS; i++) {
+		pthread_join(loops[i].thread, NULL);
+
+		if (!loops[i].fired) {
+			fprintf(stderr, "loop %d didn't see its fd fire\n", i);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < num_pairs; i++) {
+		close(pairs[i][0]);
+		close(pairs[i][1]);
+	}
+
+	free(fds);
+	free(pairs);
+
+	iv_deinit();
+
+	return 0;
+}
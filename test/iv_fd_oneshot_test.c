@@ -0,0 +1,224 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <iv.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static int pfd[2];
+static struct iv_fd fd;
+static struct iv_timer timer;
+static int calls;
+
+static void fail(char *msg)
+{
+	fprintf(stderr, "%d calls: %s\n", calls, msg);
+	exit(1);
+}
+
+static void got_in(void *cookie, int bands)
+{
+	char buf[16];
+
+	calls++;
+
+	if (!(bands & IV_FD_BAND_IN))
+		fail("called without the input band");
+
+	if (read(pfd[0], buf, sizeof(buf)) != 1)
+		fail("expected data");
+
+	if (calls == 1) {
+		iv_fd_rearm(&fd);
+		if (write(pfd[1], "x", 1) != 1)
+			fail("write failed");
+		return;
+	}
+
+	iv_fd_unregister(&fd);
+	iv_timer_unregister(&timer);
+}
+
+static void got_timer(void *cookie)
+{
+	fail("fd was not dispatched");
+}
+
+static int sock;
+static struct iv_timer shut_timer;
+
+static void got_rdhup(void *cookie, int bands)
+{
+	calls++;
+
+	if (bands != IV_FD_BAND_RDHUP)
+		fail("called with unexpected bands");
+
+	iv_fd_unregister(&fd);
+	iv_timer_unregister(&timer);
+}
+
+static void got_shut_timer(void *cookie)
+{
+	int err;
+	socklen_t len;
+
+	len = sizeof(err);
+	getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+
+	if (shutdown(sock, SHUT_RD) < 0)
+		fail("shutdown failed");
+}
+
+/*
+ * The kernel reports error conditions whether or not they were asked
+ * for, so a oneshot fd that only watches for RDHUP can be woken up,
+ * and disarmed by the kernel, with nothing to deliver.  It must still
+ * fire once RDHUP is reported later on.  A connected UDP socket is
+ * put into an error state by sending a datagram to a closed port, and
+ * is shut down for reading, which reports RDHUP, once the error has
+ * been cleared.
+ */
+static int test_unwatched_band(void)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	struct pollfd pollfd;
+	int tmp;
+
+	tmp = socket(AF_INET, SOCK_DGRAM, 0);
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (tmp < 0 || sock < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	addrlen = sizeof(addr);
+	if (bind(tmp, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    getsockname(tmp, (struct sockaddr *)&addr, &addrlen) < 0) {
+		perror("bind");
+		return 1;
+	}
+	close(tmp);
+
+	if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    send(sock, "x", 1, 0) != 1) {
+		perror("send");
+		return 1;
+	}
+
+	pollfd.fd = sock;
+	pollfd.events = 0;
+	if (poll(&pollfd, 1, 1000) != 1 || !(pollfd.revents & POLLERR)) {
+		fprintf(stderr, "socket didn't get into an error state\n");
+		return 1;
+	}
+
+	calls = 0;
+
+	IV_FD_INIT(&fd);
+	fd.fd = sock;
+	iv_fd_set_handler(&fd, got_rdhup, IV_FD_BAND_RDHUP);
+	iv_fd_set_oneshot(&fd, 1);
+	iv_fd_register(&fd);
+
+	IV_TIMER_INIT(&shut_timer);
+	iv_validate_now();
+	shut_timer.expires = iv_now;
+	shut_timer.expires.tv_nsec += 100000000;
+	if (shut_timer.expires.tv_nsec >= 1000000000) {
+		shut_timer.expires.tv_sec++;
+		shut_timer.expires.tv_nsec -= 1000000000;
+	}
+	shut_timer.handler = got_shut_timer;
+	iv_timer_register(&shut_timer);
+
+	IV_TIMER_INIT(&timer);
+	timer.expires = iv_now;
+	timer.expires.tv_sec += 2;
+	timer.handler = got_timer;
+	iv_timer_register(&timer);
+
+	iv_main();
+
+	close(sock);
+
+	return calls != 1;
+}
+
+int main()
+{
+	alarm(10);
+
+	iv_init();
+
+	if (pipe(pfd) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	IV_FD_INIT(&fd);
+	fd.fd = pfd[0];
+	iv_fd_set_handler(&fd, got_in, IV_FD_BAND_IN);
+	iv_fd_set_oneshot(&fd, 1);
+	iv_fd_set_speculative(&fd, 1);
+	iv_fd_register(&fd);
+
+	/*
+	 * The fd was queued for a speculative call on registration.
+	 * Reporting that it would block before that call happens
+	 * must not leave it disarmed with nothing to re-arm it.
+	 */
+	iv_fd_would_block(&fd, IV_FD_BAND_IN);
+
+	if (write(pfd[1], "x", 1) != 1) {
+		perror("write");
+		return 1;
+	}
+
+	IV_TIMER_INIT(&timer);
+	iv_validate_now();
+	timer.expires = iv_now;
+	timer.expires.tv_sec += 2;
+	timer.handler = got_timer;
+	iv_timer_register(&timer);
+
+	iv_main();
+
+	if (calls != 2)
+		return 1;
+
+	close(pfd[0]);
+	close(pfd[1]);
+
+	if (test_unwatched_band())
+		return 1;
+
+	iv_deinit();
+
+	return 0;
+}
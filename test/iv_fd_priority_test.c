@@ -0,0 +1,134 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iv.h>
+
+#define NUM_FDS		50
+#define BUDGET		10
+
+struct conn {
+	int		wfd;
+	struct iv_fd	fd;
+};
+
+static struct conn conns[NUM_FDS + 1];
+static struct iv_hook check;
+static int iteration;
+static int dispatched;
+static int dispatched_this_iteration;
+static int high_iteration;
+static int high_order;
+
+static void got_check(void *cookie)
+{
+	if (dispatched_this_iteration > BUDGET) {
+		fprintf(stderr, "dispatched %d fds in one iteration\n",
+			dispatched_this_iteration);
+		exit(1);
+	}
+
+	iteration++;
+	dispatched_this_iteration = 0;
+
+	if (dispatched == NUM_FDS + 1)
+		iv_hook_unregister(&check);
+}
+
+static void got_in(void *cookie)
+{
+	struct conn *c = cookie;
+
+	if (c->fd.priority == IV_FD_PRIORITY_HIGH) {
+		high_iteration = iteration;
+		high_order = dispatched;
+	} else {
+		dispatched_this_iteration++;
+	}
+
+	dispatched++;
+
+	iv_fd_unregister(&c->fd);
+	close(c->fd.fd);
+	close(c->wfd);
+}
+
+int main()
+{
+	int i;
+
+	alarm(10);
+
+	iv_init();
+
+	iv_fd_set_budget(BUDGET);
+
+	IV_HOOK_INIT(&check);
+	check.handler = got_check;
+	check.type = IV_HOOK_CHECK;
+	iv_hook_register(&check);
+
+	/*
+	 * Register the high-priority fd last, so that it would be
+	 * reported last by the kernel.
+	 */
+	for (i = 0; i <= NUM_FDS; i++) {
+		struct conn *c = &conns[i];
+		int pfd[2];
+
+		if (pipe(pfd) < 0) {
+			perror("pipe");
+			return 1;
+		}
+
+		c->wfd = pfd[1];
+
+		IV_FD_INIT(&c->fd);
+		c->fd.fd = pfd[0];
+		c->fd.cookie = c;
+		c->fd.handler_in = got_in;
+		if (i == NUM_FDS)
+			c->fd.priority = IV_FD_PRIORITY_HIGH;
+		iv_fd_register(&c->fd);
+
+		if (write(c->wfd, "x", 1) != 1) {
+			perror("write");
+			return 1;
+		}
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	if (high_iteration != 0 || high_order != 0) {
+		fprintf(stderr, "high priority fd dispatched as #%d in "
+				"iteration %d\n", high_order, high_iteration);
+		return 1;
+	}
+
+	if (iteration < NUM_FDS / BUDGET) {
+		fprintf(stderr, "only took %d iterations\n", iteration);
+		return 1;
+	}
+
+	return 0;
+}
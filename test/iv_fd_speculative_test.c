@@ -0,0 +1,155 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <iv.h>
+
+static int pfd[2];
+static struct iv_fd fd;
+static struct iv_hook prepare;
+static struct iv_timer timer;
+static int polls;
+static int state;
+
+static void got_prepare(void *cookie)
+{
+	polls++;
+}
+
+static void fail(char *msg)
+{
+	fprintf(stderr, "state %d, %d polls: %s\n", state, polls, msg);
+	exit(1);
+}
+
+static void got_timer(void *cookie)
+{
+	if (write(pfd[1], "x", 1) != 1)
+		fail("write failed");
+}
+
+static void got_in(void *cookie)
+{
+	char buf[16];
+	int ret;
+
+	ret = read(pfd[0], buf, 1);
+
+	switch (state) {
+	case 0:
+		/*
+		 * Called speculatively on registration, before the
+		 * first poll.  Leave the EAGAIN to the next call.
+		 */
+		if (polls != 0)
+			fail("not called speculatively on registration");
+		if (ret != 1)
+			fail("expected data");
+		state++;
+		break;
+
+	case 1:
+		/*
+		 * Called again speculatively, as we didn't report
+		 * EAGAIN in the previous call.
+		 */
+		if (polls != 1)
+			fail("not called again in the next iteration");
+		if (ret != -1 || errno != EAGAIN)
+			fail("expected EAGAIN");
+		iv_fd_would_block(&fd, IV_FD_BAND_IN);
+
+		iv_validate_now();
+		IV_TIMER_INIT(&timer);
+		timer.expires = iv_now;
+		timer.expires.tv_nsec += 100000000;
+		if (timer.expires.tv_nsec >= 1000000000) {
+			timer.expires.tv_sec++;
+			timer.expires.tv_nsec -= 1000000000;
+		}
+		timer.handler = got_timer;
+		iv_timer_register(&timer);
+
+		state++;
+		break;
+
+	case 2:
+		/*
+		 * Called after the kernel reported readiness.
+		 * Re-enabling the handler should trigger another
+		 * speculative call.
+		 */
+		if (ret != 1)
+			fail("expected data");
+		iv_fd_set_handler_in(&fd, NULL);
+		iv_fd_set_handler_in(&fd, got_in);
+		polls = 0;
+		state++;
+		break;
+
+	case 3:
+		if (polls != 0)
+			fail("not called speculatively on re-enable");
+		if (ret != -1 || errno != EAGAIN)
+			fail("expected EAGAIN");
+		iv_fd_would_block(&fd, IV_FD_BAND_IN);
+
+		iv_fd_unregister(&fd);
+		iv_hook_unregister(&prepare);
+		state++;
+		break;
+	}
+}
+
+int main()
+{
+	alarm(10);
+
+	iv_init();
+
+	if (pipe(pfd) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	if (write(pfd[1], "x", 1) != 1) {
+		perror("write");
+		return 1;
+	}
+
+	IV_HOOK_INIT(&prepare);
+	prepare.handler = got_prepare;
+	prepare.type = IV_HOOK_PREPARE;
+	iv_hook_register(&prepare);
+
+	IV_FD_INIT(&fd);
+	fd.fd = pfd[0];
+	fd.handler_in = got_in;
+	iv_fd_set_speculative(&fd, 1);
+	iv_fd_register(&fd);
+
+	iv_main();
+
+	iv_deinit();
+
+	return state == 4 ? 0 : 1;
+}
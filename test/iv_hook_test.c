@@ -0,0 +1,139 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iv.h>
+
+static struct iv_hook prepare;
+static struct iv_hook check;
+static struct iv_timer timer;
+static int ticks;
+static char order[64];
+
+static void log_event(char c)
+{
+	int len = strlen(order);
+
+	if (len < sizeof(order) - 1) {
+		order[len] = c;
+		order[len + 1] = 0;
+	}
+}
+
+static void got_prepare(void *cookie)
+{
+	log_event('P');
+
+	/*
+	 * A hook that re-registers itself must only run again in
+	 * the next loop iteration.
+	 */
+	iv_hook_unregister(&prepare);
+	iv_hook_register(&prepare);
+}
+
+static void got_check(void *cookie)
+{
+	log_event('C');
+
+	if (ticks == 2) {
+		iv_hook_unregister(&prepare);
+		iv_hook_unregister(&check);
+	}
+}
+
+static void got_timer(void *cookie)
+{
+	log_event('T');
+
+	if (++ticks < 3) {
+		iv_validate_now();
+		timer.expires = iv_now;
+		timer.expires.tv_nsec += 1000000;
+		if (timer.expires.tv_nsec >= 1000000000) {
+			timer.expires.tv_sec++;
+			timer.expires.tv_nsec -= 1000000000;
+		}
+		iv_timer_register(&timer);
+	}
+}
+
+/*
+ * Every loop iteration that polls for events runs the prepare hook
+ * before polling and the check hook after polling, and hooks don't
+ * keep the event loop alive by themselves, so we expect three timer
+ * expiries separated by one or more prepare/check pairs (depending
+ * on timer granularity), and nothing after the last timer expiry.
+ */
+static int order_ok(void)
+{
+	int timers;
+	int i;
+
+	timers = 0;
+	for (i = 0; order[i]; i++) {
+		if (order[i] == 'T') {
+			if (timers && order[i - 1] != 'C')
+				return 0;
+			timers++;
+		} else if (order[i] == 'P') {
+			if (!timers || order[i + 1] != 'C')
+				return 0;
+		} else if (order[i] != 'C' || order[i - 1] != 'P') {
+			return 0;
+		}
+	}
+
+	return timers == 3 && order[i - 1] == 'T';
+}
+
+int main()
+{
+	alarm(10);
+
+	iv_init();
+
+	IV_HOOK_INIT(&prepare);
+	prepare.handler = got_prepare;
+	iv_hook_register(&prepare);
+
+	IV_HOOK_INIT(&check);
+	check.handler = got_check;
+	check.type = IV_HOOK_CHECK;
+	iv_hook_register(&check);
+
+	IV_TIMER_INIT(&timer);
+	iv_validate_now();
+	timer.expires = iv_now;
+	timer.handler = got_timer;
+	iv_timer_register(&timer);
+
+	iv_main();
+
+	iv_deinit();
+
+	if (!order_ok()) {
+		fprintf(stderr, "unexpected order of events: %s\n", order);
+		return 1;
+	}
+
+	return 0;
+}
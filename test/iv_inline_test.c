@@ -0,0 +1,107 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#define IV_INLINE_FASTPATH
+#include <iv.h>
+
+static struct iv_task task;
+static struct iv_timer timer;
+static int task_ran;
+static int timer_ran;
+
+static void got_task(void *cookie)
+{
+	if (iv_task_registered(&task)) {
+		fprintf(stderr, "task still registered in its handler\n");
+		exit(1);
+	}
+
+	task_ran = 1;
+}
+
+static void got_timer(void *cookie)
+{
+	if (iv_timer_registered(&timer)) {
+		fprintf(stderr, "timer still registered in its handler\n");
+		exit(1);
+	}
+
+	timer_ran = 1;
+}
+
+int main()
+{
+	struct iv_loop *loop;
+
+	iv_init();
+
+	loop = iv_loop_get();
+
+	IV_TASK_INIT(&task);
+	task.handler = got_task;
+	if (iv_task_registered(&task)) {
+		fprintf(stderr, "task registered after IV_TASK_INIT\n");
+		return 1;
+	}
+
+	iv_loop_task_register(loop, &task);
+	if (!iv_task_registered(&task)) {
+		fprintf(stderr, "task not registered\n");
+		return 1;
+	}
+
+	/*
+	 * Mix with the out-of-line API, which must agree with the
+	 * inline versions.
+	 */
+	iv_task_unregister(&task);
+	if (iv_task_registered(&task)) {
+		fprintf(stderr, "task registered after unregister\n");
+		return 1;
+	}
+	iv_loop_task_register(loop, &task);
+
+	iv_invalidate_now();
+	iv_loop_validate_now(loop);
+
+	IV_TIMER_INIT(&timer);
+	if (iv_timer_registered(&timer)) {
+		fprintf(stderr, "timer registered after IV_TIMER_INIT\n");
+		return 1;
+	}
+	timer.expires = iv_now;
+	if (timer.expires.tv_sec == 0) {
+		fprintf(stderr, "current time not updated\n");
+		return 1;
+	}
+	timer.handler = got_timer;
+	iv_timer_register(&timer);
+	if (!iv_timer_registered(&timer)) {
+		fprintf(stderr, "timer not registered\n");
+		return 1;
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	return !(task_ran && timer_ran);
+}
@@ -0,0 +1,322 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <iv.h>
+#include <iv_listener.h>
+
+#define REJECT_MSG	"busy\n"
+
+static struct sockaddr_in addr;
+static struct iv_listener l;
+static struct iv_timer tim;
+static int accepted[3];
+static int num_accepted;
+
+static int open_listener(void)
+{
+	socklen_t addrlen;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		exit(1);
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	addrlen = sizeof(addr);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    getsockname(fd, (struct sockaddr *)&addr, &addrlen) < 0 ||
+	    listen(fd, 16) < 0) {
+		perror("bind");
+		exit(1);
+	}
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	return fd;
+}
+
+static int open_client(void)
+{
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("connect");
+		exit(1);
+	}
+
+	return fd;
+}
+
+static void arm_timer(void (*handler)(void *), int msec)
+{
+	iv_validate_now();
+	IV_TIMER_INIT(&tim);
+	tim.expires = iv_now;
+	tim.expires.tv_nsec += 1000000 * msec;
+	if (tim.expires.tv_nsec >= 1000000000) {
+		tim.expires.tv_sec++;
+		tim.expires.tv_nsec -= 1000000000;
+	}
+	tim.handler = handler;
+	iv_timer_register(&tim);
+}
+
+
+/*
+ * With room for two connections, the third one must stay in the
+ * listen backlog until a connection is closed and the number of
+ * live connections drops to ->low_conns.
+ */
+static void got_conn(void *cookie, int fd)
+{
+	if (num_accepted == 3) {
+		fprintf(stderr, "too many connections accepted\n");
+		exit(1);
+	}
+
+	accepted[num_accepted++] = fd;
+	if (num_accepted == 3)
+		iv_listener_unregister(&l);
+}
+
+static void check_paused(void *cookie)
+{
+	if (num_accepted != 2 || !iv_listener_saturated(&l)) {
+		fprintf(stderr, "listener not paused: %d accepted\n",
+			num_accepted);
+		exit(1);
+	}
+
+	close(accepted[0]);
+	iv_listener_conn_closed(&l);
+
+	if (iv_listener_saturated(&l)) {
+		fprintf(stderr, "listener not resumed\n");
+		exit(1);
+	}
+}
+
+static void test_pause(void)
+{
+	int cfd[3];
+	int i;
+
+	IV_LISTENER_INIT(&l);
+	l.fd = open_listener();
+	l.handler = got_conn;
+	l.max_conns = 2;
+	l.low_conns = 1;
+	iv_listener_register(&l);
+
+	for (i = 0; i < 3; i++)
+		cfd[i] = open_client();
+
+	arm_timer(check_paused, 100);
+
+	iv_main();
+
+	if (num_accepted != 3) {
+		fprintf(stderr, "third connection not accepted\n");
+		exit(1);
+	}
+
+	for (i = 0; i < 3; i++)
+		close(cfd[i]);
+	close(accepted[1]);
+	close(accepted[2]);
+	close(l.fd);
+}
+
+
+/*
+ * With room for one connection and rejection enabled, the second
+ * connection must be sent the canned message and then closed.
+ */
+static struct iv_fd client;
+static char buf[64];
+static int buf_len;
+
+static void got_reject_conn(void *cookie, int fd)
+{
+	accepted[num_accepted++] = fd;
+}
+
+static void client_readable(void *cookie)
+{
+	int ret;
+
+	ret = read(client.fd, buf + buf_len, sizeof(buf) - buf_len);
+	if (ret < 0) {
+		perror("read");
+		exit(1);
+	}
+
+	if (ret > 0) {
+		buf_len += ret;
+		return;
+	}
+
+	iv_fd_unregister(&client);
+	iv_listener_unregister(&l);
+}
+
+static void test_reject(void)
+{
+	int cfd[2];
+
+	num_accepted = 0;
+
+	IV_LISTENER_INIT(&l);
+	l.fd = open_listener();
+	l.handler = got_reject_conn;
+	l.max_conns = 1;
+	l.shed = IV_LISTENER_SHED_REJECT;
+	l.reject_msg = REJECT_MSG;
+	l.reject_len = strlen(REJECT_MSG);
+	iv_listener_register(&l);
+
+	cfd[0] = open_client();
+	cfd[1] = open_client();
+
+	IV_FD_INIT(&client);
+	client.fd = cfd[1];
+	client.handler_in = client_readable;
+	iv_fd_register(&client);
+
+	iv_main();
+
+	if (num_accepted != 1) {
+		fprintf(stderr, "%d connections accepted\n", num_accepted);
+		exit(1);
+	}
+
+	if (buf_len != strlen(REJECT_MSG) || memcmp(buf, REJECT_MSG, buf_len)) {
+		fprintf(stderr, "rejected connection got %d bytes\n", buf_len);
+		exit(1);
+	}
+
+	close(cfd[0]);
+	close(cfd[1]);
+	close(accepted[0]);
+	close(l.fd);
+}
+
+
+/*
+ * Stalling the event loop for much longer than ->max_latency while
+ * accepting connections must saturate the listener, and it must
+ * recover once the loop is responsive again.  Once it has gone idle,
+ * it must stop sampling the loop's latency.
+ */
+static int latency_client;
+
+static void check_idle(void *cookie)
+{
+	if (iv_timer_registered(&l.sample_timer)) {
+		fprintf(stderr, "idle listener still sampling latency\n");
+		exit(1);
+	}
+
+	iv_listener_unregister(&l);
+}
+
+static void check_recovered(void *cookie)
+{
+	if (iv_listener_saturated(&l)) {
+		fprintf(stderr, "listener still saturated\n");
+		exit(1);
+	}
+
+	arm_timer(check_idle, 1500);
+}
+
+static void check_saturated(void *cookie)
+{
+	if (!iv_listener_saturated(&l)) {
+		fprintf(stderr, "loop stall not detected\n");
+		exit(1);
+	}
+
+	arm_timer(check_recovered, 500);
+}
+
+static void stall(void *cookie)
+{
+	usleep(200000);
+	iv_invalidate_now();
+
+	arm_timer(check_saturated, 1);
+}
+
+static void got_latency_conn(void *cookie, int fd)
+{
+	close(fd);
+	close(latency_client);
+	iv_listener_conn_closed(&l);
+
+	arm_timer(stall, 50);
+}
+
+static void test_latency(void)
+{
+	IV_LISTENER_INIT(&l);
+	l.fd = open_listener();
+	l.handler = got_latency_conn;
+	l.max_latency = 20;
+	iv_listener_register(&l);
+
+	if (iv_timer_registered(&l.sample_timer)) {
+		fprintf(stderr, "listener sampling latency before "
+				"accepting connections\n");
+		exit(1);
+	}
+
+	latency_client = open_client();
+
+	iv_main();
+
+	close(l.fd);
+}
+
+int main()
+{
+	iv_init();
+
+	test_pause();
+	test_reject();
+	test_latency();
+
+	iv_deinit();
+
+	return 0;
+}
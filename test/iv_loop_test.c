@@ -0,0 +1,172 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iv.h>
+#include <iv_tls.h>
+
+static struct iv_tls_user tls_user = {
+	.sizeof_state	= sizeof(int),
+};
+
+static struct iv_loop *main_loop;
+static struct iv_loop *loop;
+
+static int pfd[2];
+static struct iv_fd fd;
+static struct iv_task main_task;
+static struct iv_task task;
+static struct iv_timer timer;
+static struct iv_hook hook;
+static int done;
+
+static void check_loop(struct iv_loop *l, char *what)
+{
+	if (iv_loop_get() != l) {
+		fprintf(stderr, "%s called with wrong current loop\n", what);
+		exit(1);
+	}
+}
+
+static void got_in(void *cookie)
+{
+	char buf[16];
+
+	check_loop(loop, "fd handler");
+
+	if (read(pfd[0], buf, sizeof(buf)) != 1) {
+		perror("read");
+		exit(1);
+	}
+
+	iv_fd_unregister(&fd);
+	close(pfd[0]);
+	close(pfd[1]);
+
+	done |= 1;
+}
+
+static void got_task(void *cookie)
+{
+	check_loop(loop, "task handler");
+
+	done |= 2;
+}
+
+static void got_timer(void *cookie)
+{
+	check_loop(loop, "timer handler");
+
+	done |= 4;
+}
+
+static void got_hook(void *cookie)
+{
+	check_loop(loop, "hook handler");
+
+	iv_hook_unregister(&hook);
+
+	done |= 16;
+}
+
+static void got_main_task(void *cookie)
+{
+	check_loop(main_loop, "main task handler");
+
+	/*
+	 * Drive the other loop from within this loop's callback.
+	 */
+	iv_loop_main(loop);
+
+	check_loop(main_loop, "main task handler after iv_loop_main");
+
+	done |= 8;
+}
+
+int main()
+{
+	alarm(10);
+
+	iv_tls_user_register(&tls_user);
+
+	iv_init();
+
+	main_loop = iv_loop_get();
+	loop = iv_loop_create();
+	check_loop(main_loop, "iv_loop_create");
+
+	if (loop == main_loop ||
+	    iv_loop_tls_user_ptr(loop, &tls_user) ==
+	    iv_tls_user_ptr(&tls_user)) {
+		fprintf(stderr, "loops are not independent\n");
+		return 1;
+	}
+
+	if (pipe(pfd) < 0) {
+		perror("pipe");
+		return 1;
+	}
+
+	if (write(pfd[1], "x", 1) != 1) {
+		perror("write");
+		return 1;
+	}
+
+	IV_FD_INIT(&fd);
+	fd.fd = pfd[0];
+	fd.handler_in = got_in;
+	iv_loop_fd_register(loop, &fd);
+
+	IV_TASK_INIT(&task);
+	task.handler = got_task;
+	iv_loop_task_register(loop, &task);
+
+	iv_loop_validate_now(loop);
+	IV_TIMER_INIT(&timer);
+	timer.expires = iv_loop_now(loop);
+	timer.expires.tv_nsec += 10000000;
+	if (timer.expires.tv_nsec >= 1000000000) {
+		timer.expires.tv_sec++;
+		timer.expires.tv_nsec -= 1000000000;
+	}
+	timer.handler = got_timer;
+	iv_loop_timer_register(loop, &timer);
+
+	IV_HOOK_INIT(&hook);
+	hook.handler = got_hook;
+	iv_loop_hook_register(loop, &hook);
+
+	IV_TASK_INIT(&main_task);
+	main_task.handler = got_main_task;
+	iv_task_register(&main_task);
+
+	iv_main();
+
+	check_loop(main_loop, "main");
+
+	iv_loop_destroy(loop);
+
+	check_loop(main_loop, "iv_loop_destroy");
+
+	iv_deinit();
+
+	return done == 31 ? 0 : 1;
+}
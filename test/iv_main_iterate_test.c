@@ -0,0 +1,184 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <iv.h>
+
+static int sfd[2];
+static struct iv_fd fd;
+static struct iv_task task;
+static struct iv_timer timer;
+static int step;
+static int written;
+
+static void got_timer(void *cookie)
+{
+	if (step != 2) {
+		fprintf(stderr, "timer ran in step %d\n", step);
+		exit(1);
+	}
+	step = 3;
+
+	iv_fd_unregister(&fd);
+}
+
+static void got_in(void *cookie)
+{
+	char buf[16];
+
+	if (step != 1) {
+		fprintf(stderr, "fd handler ran in step %d\n", step);
+		exit(1);
+	}
+	step = 2;
+
+	if (read(sfd[0], buf, sizeof(buf)) != 1) {
+		perror("read");
+		exit(1);
+	}
+
+	IV_TIMER_INIT(&timer);
+	iv_validate_now();
+	timer.expires = iv_now;
+	timer.expires.tv_nsec += 10000000;
+	if (timer.expires.tv_nsec >= 1000000000) {
+		timer.expires.tv_sec++;
+		timer.expires.tv_nsec -= 1000000000;
+	}
+	timer.handler = got_timer;
+	iv_timer_register(&timer);
+}
+
+static void got_task(void *cookie)
+{
+	if (step != 0) {
+		fprintf(stderr, "task ran in step %d\n", step);
+		exit(1);
+	}
+	step = 1;
+
+	/*
+	 * Register the fd from within an iteration, so that the
+	 * registration has to be flushed out by iv_loop_timeout()
+	 * for the loop fd to pick it up when the fd becomes ready.
+	 */
+	IV_FD_INIT(&fd);
+	fd.fd = sfd[0];
+	fd.handler_in = got_in;
+	iv_fd_register(&fd);
+}
+
+int main()
+{
+	struct iv_loop *loop;
+	struct timespec zero = { 0, 0 };
+	struct timespec tick = { 0, 1000000 };
+	int loop_fd;
+	int iterations;
+	int readable;
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sfd) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	iv_init();
+
+	loop = iv_loop_get();
+	loop_fd = iv_loop_fd(loop);
+
+	IV_TASK_INIT(&task);
+	task.handler = got_task;
+	iv_task_register(&task);
+
+	iterations = 0;
+	readable = 0;
+	while (1) {
+		struct timespec to;
+		struct pollfd pfd;
+		int msec;
+		int ret;
+
+		if (++iterations > 1000) {
+			fprintf(stderr, "loop didn't terminate\n");
+			return 1;
+		}
+
+		/*
+		 * Make the fd readable from outside of ivykis, as
+		 * the foreign event loop would.
+		 */
+		if (step == 1 && !written) {
+			if (write(sfd[1], "x", 1) != 1) {
+				perror("write");
+				return 1;
+			}
+			written = 1;
+		}
+
+		/*
+		 * Without a loop fd, fall back to bounded iterations.
+		 */
+		if (loop_fd < 0) {
+			if (!iv_main_iterate(&tick))
+				break;
+			continue;
+		}
+
+		msec = -1;
+		if (iv_loop_timeout(loop, &to))
+			msec = 1000 * to.tv_sec + (to.tv_nsec + 999999) / 1000000;
+
+		pfd.fd = loop_fd;
+		pfd.events = POLLIN;
+		do {
+			ret = poll(&pfd, 1, msec);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret < 0) {
+			perror("poll");
+			return 1;
+		}
+
+		if (ret > 0 && (pfd.revents & POLLIN))
+			readable++;
+
+		if (!iv_main_iterate(&zero))
+			break;
+	}
+
+	if (step != 3) {
+		fprintf(stderr, "loop exited in step %d\n", step);
+		return 1;
+	}
+
+	if (loop_fd >= 0 && !readable) {
+		fprintf(stderr, "loop fd never polled readable\n");
+		return 1;
+	}
+
+	iv_deinit();
+
+	return 0;
+}
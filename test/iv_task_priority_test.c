@@ -0,0 +1,121 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iv.h>
+
+static struct iv_task high;
+static struct iv_task high2;
+static struct iv_task normal;
+static struct iv_task idle;
+static struct iv_timer timer;
+static int normal_runs;
+static char order[64];
+
+static void log_event(char c)
+{
+	int len = strlen(order);
+
+	if (len < sizeof(order) - 1) {
+		order[len] = c;
+		order[len + 1] = 0;
+	}
+}
+
+static void got_high(void *cookie)
+{
+	log_event('H');
+}
+
+static void got_high2(void *cookie)
+{
+	log_event('h');
+}
+
+static void got_normal(void *cookie)
+{
+	log_event('N');
+
+	if (normal_runs++ == 0)
+		iv_task_register(&high2);
+
+	if (normal_runs < 3)
+		iv_task_register(&normal);
+}
+
+static void got_idle(void *cookie)
+{
+	log_event('I');
+}
+
+static void got_timer(void *cookie)
+{
+	log_event('T');
+}
+
+int main()
+{
+	alarm(10);
+
+	iv_init();
+
+	IV_TASK_INIT(&high);
+	high.handler = got_high;
+	high.priority = IV_TASK_PRIORITY_HIGH;
+
+	IV_TASK_INIT(&high2);
+	high2.handler = got_high2;
+	high2.priority = IV_TASK_PRIORITY_HIGH;
+
+	IV_TASK_INIT(&normal);
+	normal.handler = got_normal;
+
+	IV_TASK_INIT(&idle);
+	idle.handler = got_idle;
+	idle.priority = IV_TASK_PRIORITY_IDLE;
+
+	IV_TIMER_INIT(&timer);
+	iv_validate_now();
+	timer.expires = iv_now;
+	timer.handler = got_timer;
+
+	iv_task_register(&idle);
+	iv_task_register(&normal);
+	iv_task_register(&high);
+	iv_timer_register(&timer);
+
+	iv_main();
+
+	iv_deinit();
+
+	/*
+	 * The high-priority task runs before the normal-priority one,
+	 * and the high-priority task that that one registers runs
+	 * before the timer.  The idle task only runs once the normal
+	 * task has stopped rescheduling itself.
+	 */
+	if (strcmp(order, "HNhTNNI")) {
+		fprintf(stderr, "unexpected order of events: %s\n", order);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <iv.h>
+#include <iv_tls.h>
+
+struct remote_state {
+	int	counter;
+};
+
+static int inited;
+
+static void init_thread(void *st)
+{
+	inited = 1;
+}
+
+static struct iv_tls_user before = {
+	.sizeof_state	= 3,
+};
+
+static struct iv_tls_user aligned = {
+	.sizeof_state	= sizeof(struct remote_state),
+	.init_thread	= init_thread,
+};
+
+static struct iv_tls_user after = {
+	.sizeof_state	= 8,
+};
+
+static void register_users(void) __attribute__((constructor));
+static void register_users(void)
+{
+	iv_tls_user_register(&before);
+	iv_tls_user_register_aligned(&aligned, IV_TLS_CACHELINE_SIZE);
+	iv_tls_user_register(&after);
+}
+
+static void check_loop(struct iv_loop *loop)
+{
+	uintptr_t a;
+	uintptr_t b;
+	uintptr_t c;
+
+	a = (uintptr_t)iv_loop_tls_user_ptr(loop, &before);
+	b = (uintptr_t)iv_loop_tls_user_ptr(loop, &aligned);
+	c = (uintptr_t)iv_loop_tls_user_ptr(loop, &after);
+
+	if (b % IV_TLS_CACHELINE_SIZE) {
+		fprintf(stderr, "aligned state at %p is misaligned\n",
+			(void *)b);
+		exit(1);
+	}
+
+	/*
+	 * The aligned state mustn't share a cache line with the states
+	 * registered before and after it.
+	 */
+	if ((a + before.sizeof_state - 1) / IV_TLS_CACHELINE_SIZE ==
+	    b / IV_TLS_CACHELINE_SIZE ||
+	    (b + aligned.sizeof_state - 1) / IV_TLS_CACHELINE_SIZE ==
+	    c / IV_TLS_CACHELINE_SIZE) {
+		fprintf(stderr, "aligned state shares a cache line\n");
+		exit(1);
+	}
+
+	if (((struct remote_state *)b)->counter != 0) {
+		fprintf(stderr, "aligned state not zeroed\n");
+		exit(1);
+	}
+}
+
+int main()
+{
+	struct iv_loop *loop;
+
+	iv_init();
+
+	if (!inited) {
+		fprintf(stderr, "init_thread not called\n");
+		return 1;
+	}
+
+	check_loop(iv_loop_get());
+
+	loop = iv_loop_create();
+	check_loop(loop);
+	iv_loop_destroy(loop);
+
+	iv_deinit();
+
+	return 0;
+}
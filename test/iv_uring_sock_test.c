@@ -0,0 +1,239 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <iv.h>
+#include <iv_uring_sock.h>
+
+#define NUM_MSGS	100
+#define MSG		"hello, world\n"
+#define MSG_LEN		(sizeof(MSG) - 1)
+
+static struct iv_uring_sock listener;
+static struct iv_uring_sock server;
+static struct iv_uring_sock client;
+static int server_fd = -1;
+static int echoed;
+static int got_eof;
+static char rxbuf[NUM_MSGS * MSG_LEN];
+static int rxlen;
+
+
+/*
+ * The server side echoes back everything it receives, and closes
+ * the connection when the client has shut down its side.
+ */
+static void server_recv(void *cookie, void *buf, int len)
+{
+	if (len < 0) {
+		fprintf(stderr, "server recv: %s\n", strerror(-len));
+		exit(1);
+	}
+
+	if (len == 0) {
+		got_eof = 1;
+		iv_uring_sock_unregister(&server);
+		close(server_fd);
+		return;
+	}
+
+	if (iv_uring_sock_send(&server, buf, len) < 0) {
+		perror("iv_uring_sock_send");
+		exit(1);
+	}
+}
+
+static void server_send(void *cookie, int ret)
+{
+	if (ret < 0) {
+		fprintf(stderr, "server send: %s\n", strerror(-ret));
+		exit(1);
+	}
+
+	echoed += ret;
+}
+
+static void got_conn(void *cookie, int fd)
+{
+	if (fd < 0) {
+		fprintf(stderr, "accept: %s\n", strerror(-fd));
+		exit(1);
+	}
+
+	if (server_fd != -1) {
+		fprintf(stderr, "accepted a second connection\n");
+		exit(1);
+	}
+
+	iv_uring_sock_unregister(&listener);
+
+	server_fd = fd;
+
+	IV_URING_SOCK_INIT(&server);
+	server.fd = fd;
+	server.handler_recv = server_recv;
+	server.handler_send = server_send;
+	if (iv_uring_sock_register(&server) < 0 ||
+	    iv_uring_sock_recv(&server) < 0) {
+		perror("server");
+		exit(1);
+	}
+}
+
+
+/*
+ * The client side sends a number of messages back to back, and
+ * shuts down its side of the connection once they have all been
+ * echoed back.
+ */
+static void client_recv(void *cookie, void *buf, int len)
+{
+	if (len <= 0) {
+		if (len < 0)
+			fprintf(stderr, "client recv: %s\n", strerror(-len));
+		else if (rxlen != sizeof(rxbuf))
+			fprintf(stderr, "client saw early EOF\n");
+		if (len < 0 || rxlen != sizeof(rxbuf))
+			exit(1);
+
+		iv_uring_sock_unregister(&client);
+		return;
+	}
+
+	if (rxlen + len > sizeof(rxbuf)) {
+		fprintf(stderr, "client received too much data\n");
+		exit(1);
+	}
+
+	memcpy(rxbuf + rxlen, buf, len);
+	rxlen += len;
+
+	if (rxlen == sizeof(rxbuf))
+		shutdown(client.fd, SHUT_WR);
+}
+
+static void client_connected(void *cookie, int ret)
+{
+	int i;
+
+	if (ret < 0) {
+		fprintf(stderr, "connect: %s\n", strerror(-ret));
+		exit(1);
+	}
+
+	if (iv_uring_sock_recv(&client) < 0) {
+		perror("iv_uring_sock_recv");
+		exit(1);
+	}
+
+	for (i = 0; i < NUM_MSGS; i++) {
+		if (iv_uring_sock_send(&client, MSG, MSG_LEN) < 0) {
+			perror("iv_uring_sock_send");
+			exit(1);
+		}
+	}
+}
+
+int main()
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen;
+	int lfd;
+	int i;
+
+	iv_init();
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0) {
+		perror("socket");
+		return 1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	addrlen = sizeof(addr);
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &addrlen) < 0 ||
+	    listen(lfd, 1) < 0) {
+		perror("bind");
+		return 1;
+	}
+
+	IV_URING_SOCK_INIT(&listener);
+	listener.fd = lfd;
+	listener.handler_accept = got_conn;
+	if (iv_uring_sock_register(&listener) < 0) {
+		/*
+		 * Exit status 77 tells automake that the test was
+		 * skipped, as io_uring is not available at run time.
+		 */
+		if (errno == ENOSYS || errno == EPERM || errno == EINVAL)
+			return 77;
+
+		perror("iv_uring_sock_register");
+		return 1;
+	}
+
+	if (iv_uring_sock_accept(&listener) < 0) {
+		perror("iv_uring_sock_accept");
+		return 1;
+	}
+
+	IV_URING_SOCK_INIT(&client);
+	client.fd = socket(AF_INET, SOCK_STREAM, 0);
+	client.handler_recv = client_recv;
+	client.handler_connect = client_connected;
+	if (client.fd < 0 || iv_uring_sock_register(&client) < 0 ||
+	    iv_uring_sock_connect(&client, (struct sockaddr *)&addr,
+				  addrlen) < 0) {
+		perror("client");
+		return 1;
+	}
+
+	iv_main();
+
+	if (!got_eof || echoed != sizeof(rxbuf)) {
+		fprintf(stderr, "server saw EOF %d, echoed %d bytes\n",
+			got_eof, echoed);
+		return 1;
+	}
+
+	for (i = 0; i < NUM_MSGS; i++) {
+		if (memcmp(rxbuf + i * MSG_LEN, MSG, MSG_LEN)) {
+			fprintf(stderr, "message %d corrupted\n", i);
+			return 1;
+		}
+	}
+
+	close(client.fd);
+	close(lfd);
+
+	iv_deinit();
+
+	return 0;
+}
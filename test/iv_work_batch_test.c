@@ -0,0 +1,124 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define NUM_ITEMS	10000
+#define BATCH		100
+#define BUDGET		250
+
+static struct iv_work_pool pool;
+static struct iv_work_item items[NUM_ITEMS];
+static int done[NUM_ITEMS];
+static int completed;
+
+static void work(void *cookie)
+{
+	int *d = cookie;
+
+	(*d)++;
+}
+
+static void work_complete(void *cookie)
+{
+	fprintf(stderr, "per-item completion called\n");
+	exit(1);
+}
+
+static void work_complete_batch(void *cookie, struct iv_work_item **w, int num)
+{
+	int i;
+
+	if (num > BUDGET) {
+		fprintf(stderr, "got batch of %d items, over budget\n", num);
+		exit(1);
+	}
+
+	for (i = 0; i < num; i++) {
+		int *d = w[i]->cookie;
+
+		if (*d != 1) {
+			fprintf(stderr, "item %d ran %d times\n",
+				(int)(d - done), *d);
+			exit(1);
+		}
+		(*d)++;
+	}
+
+	completed += num;
+	if (completed == NUM_ITEMS)
+		iv_work_pool_put(&pool);
+}
+
+static int run(int lightweight)
+{
+	struct iv_work_item *batch[BATCH];
+	int i;
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = 8;
+	pool.max_completions = BUDGET;
+	pool.completion_batch = work_complete_batch;
+	pool.lightweight = lightweight;
+	iv_work_pool_create(&pool);
+
+	completed = 0;
+	for (i = 0; i < NUM_ITEMS; i++) {
+		done[i] = 0;
+
+		IV_WORK_ITEM_INIT(&items[i]);
+		items[i].cookie = &done[i];
+		items[i].work = work;
+		items[i].completion = work_complete;
+
+		batch[i % BATCH] = &items[i];
+		if (i % BATCH == BATCH - 1)
+			iv_work_pool_submit_batch(&pool, batch, BATCH);
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	if (completed != NUM_ITEMS) {
+		fprintf(stderr, "only completed %d items (vs %d)\n",
+			completed, NUM_ITEMS);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	alarm(60);
+
+	if (run(0))
+		return 1;
+
+	if (run(1))
+		return 1;
+
+	return 0;
+}
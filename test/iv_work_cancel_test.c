@@ -0,0 +1,152 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define NUM_ITEMS	6
+
+static struct iv_work_pool pool;
+static struct iv_work_item items[NUM_ITEMS];
+static int ran[NUM_ITEMS];
+static int status[NUM_ITEMS];
+static int completions;
+
+/*
+ * Item 0 is of high priority, so that it is picked up first, and
+ * it keeps the pool's only thread busy while the other items are
+ * queued up behind it:
+ *
+ *	item 1 is canceled and should be completed as such,
+ *	item 2 is canceled silently and should not be completed,
+ *	item 3 has a deadline that will have passed when it's dequeued,
+ *	item 4 has an execution timeout it will overrun,
+ *	item 5 should run normally.
+ */
+static int expected[NUM_ITEMS] = {
+	IV_WORK_STATUS_DONE,
+	IV_WORK_STATUS_CANCELLED,
+	-1,
+	IV_WORK_STATUS_EXPIRED,
+	IV_WORK_STATUS_OVERRUN,
+	IV_WORK_STATUS_DONE,
+};
+
+static void work(void *cookie)
+{
+	struct iv_work_item *w = cookie;
+	int i = w - items;
+
+	ran[i]++;
+	if (i == 0 || i == 4)
+		usleep(100000);
+}
+
+static void work_complete(void *cookie)
+{
+	struct iv_work_item *w = cookie;
+	int i = w - items;
+
+	status[i] = w->status;
+
+	if (++completions == NUM_ITEMS - 1)
+		iv_work_pool_put(&pool);
+}
+
+int main()
+{
+	int fail;
+	int i;
+
+	alarm(30);
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = 1;
+	iv_work_pool_create(&pool);
+
+	iv_validate_now();
+
+	for (i = 0; i < NUM_ITEMS; i++) {
+		IV_WORK_ITEM_INIT(&items[i]);
+		items[i].cookie = &items[i];
+		items[i].work = work;
+		items[i].completion = work_complete;
+		status[i] = -1;
+
+		if (i == 0)
+			items[i].priority = IV_WORK_PRIORITY_HIGH;
+
+		if (i == 3) {
+			items[i].deadline = iv_now;
+			items[i].deadline.tv_nsec += 50000000;
+			if (items[i].deadline.tv_nsec >= 1000000000) {
+				items[i].deadline.tv_sec++;
+				items[i].deadline.tv_nsec -= 1000000000;
+			}
+		}
+
+		if (i == 4)
+			items[i].timeout = 10;
+
+		iv_work_pool_submit_work(&pool, &items[i]);
+	}
+
+	if (iv_work_pool_cancel(&items[1], 0)) {
+		fprintf(stderr, "failed to cancel item 1\n");
+		return 1;
+	}
+
+	if (iv_work_pool_cancel(&items[2], IV_WORK_CANCEL_FLAG_SILENT)) {
+		fprintf(stderr, "failed to cancel item 2\n");
+		return 1;
+	}
+
+	if (!iv_work_pool_cancel(&items[2], 0)) {
+		fprintf(stderr, "canceled item 2 twice\n");
+		return 1;
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	fail = 0;
+	for (i = 0; i < NUM_ITEMS; i++) {
+		int should_run;
+
+		if (status[i] != expected[i]) {
+			fprintf(stderr, "item %d: status %d, expected %d\n",
+				i, status[i], expected[i]);
+			fail = 1;
+		}
+
+		should_run = expected[i] == IV_WORK_STATUS_DONE ||
+			     expected[i] == IV_WORK_STATUS_OVERRUN;
+		if (ran[i] != should_run) {
+			fprintf(stderr, "item %d: ran %d times\n", i, ran[i]);
+			fail = 1;
+		}
+	}
+
+	return fail;
+}
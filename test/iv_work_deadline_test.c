@@ -0,0 +1,149 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define NUM_ITEMS	16
+
+static struct iv_work_pool pool;
+static struct iv_work_item blocker;
+static struct iv_work_item items[NUM_ITEMS];
+static struct iv_work_group group;
+static struct iv_work_item late;
+static int late_ran;
+static volatile int started;
+static int order[NUM_ITEMS];
+static int num_run;
+static int completed;
+
+static void work_block(void *cookie)
+{
+	started = 1;
+	usleep(100000);
+}
+
+static void work(void *cookie)
+{
+	struct iv_work_item *w = cookie;
+
+	order[num_run++] = w - items;
+}
+
+static void work_complete(void *cookie)
+{
+	if (++completed == NUM_ITEMS + 2)
+		iv_work_pool_put(&pool);
+}
+
+static void work_late(void *cookie)
+{
+	late_ran = 1;
+}
+
+static void late_complete(void *cookie)
+{
+	fprintf(stderr, "per-item completion called for group item\n");
+	exit(1);
+}
+
+static void group_complete(void *cookie)
+{
+	if (!late_ran) {
+		fprintf(stderr, "group item was expired\n");
+		exit(1);
+	}
+
+	work_complete(cookie);
+}
+
+int main()
+{
+	struct timespec deadline;
+	int i;
+
+	alarm(30);
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = 1;
+	iv_work_pool_create(&pool);
+
+	/*
+	 * Keep the only pool thread busy, so that the following work
+	 * items stay queued.
+	 */
+	IV_WORK_ITEM_INIT(&blocker);
+	blocker.work = work_block;
+	blocker.completion = work_complete;
+	iv_work_pool_submit_work(&pool, &blocker);
+	while (!started)
+		usleep(1000);
+
+	/*
+	 * Submit items that all have the same deadline, in reverse
+	 * order of their addresses, and expect them to be run in
+	 * the order in which they were submitted.
+	 */
+	iv_validate_now();
+	deadline = iv_now;
+	deadline.tv_sec += 60;
+
+	for (i = NUM_ITEMS - 1; i >= 0; i--) {
+		IV_WORK_ITEM_INIT(&items[i]);
+		items[i].cookie = &items[i];
+		items[i].work = work;
+		items[i].completion = work_complete;
+		items[i].deadline = deadline;
+		iv_work_pool_submit_work(&pool, &items[i]);
+	}
+
+	/*
+	 * A group member whose deadline passes while it is queued
+	 * must still be run, as its group's completion couldn't
+	 * report that it wasn't.
+	 */
+	IV_WORK_GROUP_INIT(&group);
+	group.completion = group_complete;
+
+	IV_WORK_ITEM_INIT(&late);
+	late.work = work_late;
+	late.completion = late_complete;
+	late.deadline = iv_now;
+	iv_work_group_fork(&pool, &group, &late);
+	iv_work_group_join(&group);
+
+	iv_main();
+
+	iv_deinit();
+
+	for (i = 0; i < NUM_ITEMS; i++) {
+		if (order[i] != NUM_ITEMS - 1 - i) {
+			fprintf(stderr, "item %d ran as number %d\n",
+				order[i], i);
+			return 1;
+		}
+	}
+
+	return 0;
+}
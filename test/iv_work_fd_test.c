@@ -0,0 +1,132 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define NUM_BYTES	100
+
+static struct iv_work_pool pool;
+static int sfd[2];
+static struct iv_work_fd wfd;
+static struct iv_timer timer;
+static int written;
+static volatile int running;
+static volatile int received;
+static int overlap;
+
+static void handler(void *cookie, int bands)
+{
+	char buf[NUM_BYTES];
+	int ret;
+
+	if (__sync_fetch_and_add(&running, 1))
+		overlap = 1;
+
+	if (bands != IV_FD_BAND_IN) {
+		fprintf(stderr, "got bands %x\n", bands);
+		exit(1);
+	}
+
+	ret = read(sfd[0], buf, sizeof(buf));
+	if (ret > 0)
+		__sync_fetch_and_add(&received, ret);
+
+	/*
+	 * Dawdle a bit, to give other worker threads a chance to
+	 * pick up the fd if it were to be dispatched again.
+	 */
+	usleep(1000);
+
+	__sync_fetch_and_sub(&running, 1);
+}
+
+static void completion(void *cookie)
+{
+	if (received == NUM_BYTES) {
+		if (iv_work_fd_unregister(&wfd)) {
+			fprintf(stderr, "handler still running\n");
+			exit(1);
+		}
+		iv_work_pool_put(&pool);
+	}
+}
+
+static void got_timer(void *cookie)
+{
+	if (write(sfd[1], "x", 1) != 1) {
+		perror("write");
+		exit(1);
+	}
+
+	if (++written < NUM_BYTES) {
+		timer.expires.tv_nsec += 200000;
+		if (timer.expires.tv_nsec >= 1000000000) {
+			timer.expires.tv_sec++;
+			timer.expires.tv_nsec -= 1000000000;
+		}
+		iv_timer_register(&timer);
+	}
+}
+
+int main()
+{
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sfd) < 0) {
+		perror("socketpair");
+		return 1;
+	}
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = 4;
+	iv_work_pool_create(&pool);
+
+	IV_WORK_FD_INIT(&wfd);
+	wfd.fd = sfd[0];
+	wfd.handler = handler;
+	wfd.completion = completion;
+	iv_work_fd_register(&pool, &wfd);
+
+	IV_TIMER_INIT(&timer);
+	iv_validate_now();
+	timer.expires = iv_now;
+	timer.handler = got_timer;
+	iv_timer_register(&timer);
+
+	iv_main();
+
+	iv_deinit();
+
+	if (overlap) {
+		fprintf(stderr, "handler ran in two threads at once\n");
+		return 1;
+	}
+
+	if (received != NUM_BYTES) {
+		fprintf(stderr, "received %d bytes\n", received);
+		return 1;
+	}
+
+	return 0;
+}
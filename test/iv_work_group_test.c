@@ -0,0 +1,194 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define RANGE		100000
+#define GRAIN		1000
+#define NUM_SUBTASKS	16
+
+static struct iv_work_pool pool;
+static struct iv_work_group group;
+static unsigned char visited[RANGE];
+static struct iv_work_item subtasks[NUM_SUBTASKS];
+static int subtask_done[NUM_SUBTASKS];
+static int completions;
+
+static void range_fn(void *cookie, int begin, int end)
+{
+	int i;
+
+	if (cookie != &group) {
+		fprintf(stderr, "range function called with wrong cookie\n");
+		exit(1);
+	}
+
+	for (i = begin; i < end; i++)
+		visited[i]++;
+}
+
+static void subtask_even(void *cookie)
+{
+	int *d = cookie;
+
+	*d += 2;
+}
+
+static void subtask_odd(void *cookie)
+{
+	int *d = cookie;
+
+	*d += 1;
+}
+
+static void subtask_complete(void *cookie)
+{
+	fprintf(stderr, "per-item completion called\n");
+	exit(1);
+}
+
+static void group_complete(void *cookie)
+{
+	completions++;
+	iv_quit();
+}
+
+static int check_range(void)
+{
+	int i;
+
+	for (i = 0; i < RANGE; i++) {
+		if (visited[i] != 1) {
+			fprintf(stderr, "index %d visited %d times\n",
+				i, visited[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int check_subtasks(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_SUBTASKS; i++) {
+		if (subtask_done[i] != ((i & 1) ? 1 : 2)) {
+			fprintf(stderr, "subtask %d didn't run correctly\n", i);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int run(struct iv_work_pool *p)
+{
+	int i;
+
+	iv_init();
+
+	if (p != NULL) {
+		IV_WORK_POOL_INIT(p);
+		p->max_threads = 4;
+		iv_work_pool_create(p);
+	}
+
+	completions = 0;
+
+	memset(visited, 0, sizeof(visited));
+	IV_WORK_GROUP_INIT(&group);
+	group.cookie = &group;
+	group.completion = group_complete;
+	if (iv_work_parallel_for(p, &group, 0, RANGE, GRAIN, range_fn) < 0) {
+		fprintf(stderr, "iv_work_parallel_for failed\n");
+		return 1;
+	}
+
+	/*
+	 * The group can't be reused for another range before it has
+	 * completed and been reinitialised.
+	 */
+	if (!iv_work_parallel_for(p, &group, 0, RANGE, GRAIN, range_fn)) {
+		fprintf(stderr, "iv_work_parallel_for reused a group\n");
+		return 1;
+	}
+
+	iv_main();
+
+	if (completions != 1 || check_range())
+		return 1;
+
+	IV_WORK_GROUP_INIT(&group);
+	group.cookie = &group;
+	group.completion = group_complete;
+	for (i = 0; i < NUM_SUBTASKS; i++) {
+		subtask_done[i] = 0;
+
+		IV_WORK_ITEM_INIT(&subtasks[i]);
+		subtasks[i].cookie = &subtask_done[i];
+		subtasks[i].work = (i & 1) ? subtask_odd : subtask_even;
+		subtasks[i].completion = subtask_complete;
+		iv_work_group_fork(p, &group, &subtasks[i]);
+	}
+	iv_work_group_join(&group);
+
+	iv_main();
+
+	if (completions != 2 || check_subtasks())
+		return 1;
+
+	IV_WORK_GROUP_INIT(&group);
+	group.cookie = &group;
+	group.completion = group_complete;
+	iv_work_parallel_for(p, &group, 0, 0, GRAIN, range_fn);
+
+	iv_main();
+
+	if (completions != 3) {
+		fprintf(stderr, "empty range didn't complete\n");
+		return 1;
+	}
+
+	if (p != NULL)
+		iv_work_pool_put(p);
+
+	iv_main();
+
+	iv_deinit();
+
+	return 0;
+}
+
+int main()
+{
+	alarm(60);
+
+	if (run(&pool))
+		return 1;
+
+	if (run(NULL))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define MIN_THREADS	2
+#define MAX_THREADS	6
+#define IDLE_TIMEOUT	50
+#define NUM_ITEMS	24
+
+static struct iv_work_pool pool;
+static struct iv_work_item items[NUM_ITEMS];
+static struct iv_timer timer;
+static int running_threads;
+static int completed;
+static int checks;
+static int fail;
+
+static void thread_start(void *cookie)
+{
+	__sync_add_and_fetch(&running_threads, 1);
+}
+
+static void thread_stop(void *cookie)
+{
+	__sync_sub_and_fetch(&running_threads, 1);
+}
+
+static void work(void *cookie)
+{
+	usleep(10000);
+}
+
+static void arm_timer(void)
+{
+	iv_validate_now();
+	timer.expires = iv_now;
+	timer.expires.tv_nsec += 4 * IDLE_TIMEOUT * 1000000;
+	while (timer.expires.tv_nsec >= 1000000000) {
+		timer.expires.tv_sec++;
+		timer.expires.tv_nsec -= 1000000000;
+	}
+	iv_timer_register(&timer);
+}
+
+static void work_complete(void *cookie)
+{
+	if (++completed == NUM_ITEMS)
+		arm_timer();
+}
+
+/*
+ * Once the pool has grown under load and then drained, it should
+ * shrink back to its minimum size, and stay there over multiple
+ * idle timeout periods.
+ */
+static void got_timer(void *cookie)
+{
+	int running = __sync_add_and_fetch(&running_threads, 0);
+
+	if (running != MIN_THREADS) {
+		fprintf(stderr, "check %d: %d threads running (vs %d)\n",
+			checks, running, MIN_THREADS);
+		fail = 1;
+	}
+
+	if (++checks < 3)
+		arm_timer();
+	else
+		iv_work_pool_put(&pool);
+}
+
+static int run(int lightweight)
+{
+	int i;
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = MAX_THREADS;
+	pool.min_threads = MIN_THREADS;
+	pool.idle_timeout = IDLE_TIMEOUT;
+	pool.thread_start = thread_start;
+	pool.thread_stop = thread_stop;
+	pool.lightweight = lightweight;
+	iv_work_pool_create(&pool);
+
+	IV_TIMER_INIT(&timer);
+	timer.handler = got_timer;
+
+	completed = 0;
+	checks = 0;
+	for (i = 0; i < NUM_ITEMS; i++) {
+		IV_WORK_ITEM_INIT(&items[i]);
+		items[i].work = work;
+		items[i].completion = work_complete;
+		iv_work_pool_submit_work(&pool, &items[i]);
+	}
+
+	iv_main();
+
+	iv_deinit();
+
+	return fail;
+}
+
+int main()
+{
+	alarm(30);
+
+	if (run(0))
+		return 1;
+
+	if (run(1))
+		return 1;
+
+	return 0;
+}
@@ -0,0 +1,302 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iv.h>
+#include <iv_work.h>
+
+#define DEPTH		4
+#define NUM_ITEMS	(DEPTH + 3)
+
+static struct iv_work_pool pool;
+static struct iv_work_item items[NUM_ITEMS];
+static volatile int started;
+static int completed;
+static int expected;
+static int dropped;
+static int space_notified;
+
+#define RANGE		100
+#define NUM_SUBTASKS	2
+
+static struct iv_work_group range_group;
+static struct iv_work_group fork_group;
+static struct iv_work_item subtasks[NUM_SUBTASKS];
+static int range_done;
+static int subtasks_done;
+static int groups_pending;
+
+static void work_block(void *cookie)
+{
+	started = 1;
+	usleep(200000);
+}
+
+static void work(void *cookie)
+{
+}
+
+static void work_complete(void *cookie)
+{
+	struct iv_work_item *w = cookie;
+
+	if (w->status == IV_WORK_STATUS_DROPPED)
+		dropped++;
+
+	if (++completed == expected)
+		iv_work_pool_put(&pool);
+}
+
+static void space_available(void *cookie)
+{
+	space_notified++;
+}
+
+static int run(int policy)
+{
+	int submitted;
+	int i;
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = 1;
+	pool.lightweight = 1;
+	pool.max_queue_depth = DEPTH;
+	pool.queue_policy = policy;
+	pool.queue_low_watermark = 1;
+	pool.space_available = space_available;
+	iv_work_pool_create(&pool);
+
+	started = 0;
+	completed = 0;
+	dropped = 0;
+	space_notified = 0;
+
+	for (i = 0; i < NUM_ITEMS; i++) {
+		IV_WORK_ITEM_INIT(&items[i]);
+		items[i].cookie = &items[i];
+		items[i].work = i ? work : work_block;
+		items[i].completion = work_complete;
+	}
+
+	/*
+	 * Keep the only pool thread busy, so that the following work
+	 * items stay queued.
+	 */
+	iv_work_pool_submit_work(&pool, &items[0]);
+	while (!started)
+		usleep(1000);
+
+	submitted = 1;
+	for (i = 1; i < NUM_ITEMS; i++) {
+		if (!iv_work_pool_submit_work(&pool, &items[i]))
+			submitted++;
+	}
+
+	expected = submitted;
+
+	iv_main();
+
+	iv_deinit();
+
+	if (policy == IV_WORK_QUEUE_DROP_OLDEST) {
+		if (submitted != NUM_ITEMS ||
+		    dropped != NUM_ITEMS - 1 - DEPTH ||
+		    items[1].status != IV_WORK_STATUS_DROPPED ||
+		    items[NUM_ITEMS - 1].status != IV_WORK_STATUS_DONE) {
+			fprintf(stderr, "drop oldest: submitted %d, "
+					"dropped %d\n", submitted, dropped);
+			return 1;
+		}
+	} else {
+		if (submitted != DEPTH + 1 || dropped) {
+			fprintf(stderr, "policy %d: submitted %d (vs %d)\n",
+				policy, submitted, DEPTH + 1);
+			return 1;
+		}
+	}
+
+	if (space_notified != (policy == IV_WORK_QUEUE_NOTIFY)) {
+		fprintf(stderr, "policy %d: space notified %d times\n",
+			policy, space_notified);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void range_fn(void *cookie, int begin, int end)
+{
+	__sync_fetch_and_add(&range_done, end - begin);
+}
+
+static void subtask(void *cookie)
+{
+	__sync_fetch_and_add(&subtasks_done, 1);
+}
+
+static void subtask_complete(void *cookie)
+{
+	fprintf(stderr, "per-item completion called for group item\n");
+	exit(1);
+}
+
+static void group_complete(void *cookie)
+{
+	if (cookie == &range_group && range_done != RANGE) {
+		fprintf(stderr, "range group completed with %d of %d "
+				"elements processed\n", range_done, RANGE);
+		exit(1);
+	}
+
+	if (cookie == &fork_group && subtasks_done != NUM_SUBTASKS) {
+		fprintf(stderr, "fork group completed with %d of %d "
+				"subtasks run\n", subtasks_done, NUM_SUBTASKS);
+		exit(1);
+	}
+
+	if (!--groups_pending && completed == expected)
+		iv_work_pool_put(&pool);
+}
+
+static void group_work_complete(void *cookie)
+{
+	struct iv_work_item *w = cookie;
+
+	if (w->status == IV_WORK_STATUS_DROPPED)
+		dropped++;
+
+	if (++completed == expected && !groups_pending)
+		iv_work_pool_put(&pool);
+}
+
+/*
+ * Work items that are part of a group must never be dropped to make
+ * room for new work on a full DROP_OLDEST pool, as their group would
+ * then complete without them having run.  If @plain_first is set, a
+ * plain work item is queued ahead of the groups' work items, and it
+ * is the one that is dropped, otherwise there is nothing that can be
+ * dropped and the submission has to fail.
+ */
+static int run_groups(int plain_first)
+{
+	int submitted;
+	int i;
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = 1;
+	pool.lightweight = 1;
+	pool.max_queue_depth = 1;
+	pool.queue_policy = IV_WORK_QUEUE_DROP_OLDEST;
+	iv_work_pool_create(&pool);
+
+	started = 0;
+	completed = 0;
+	dropped = 0;
+	range_done = 0;
+	subtasks_done = 0;
+	groups_pending = 2;
+
+	for (i = 0; i < 3; i++) {
+		IV_WORK_ITEM_INIT(&items[i]);
+		items[i].cookie = &items[i];
+		items[i].work = i ? work : work_block;
+		items[i].completion = group_work_complete;
+	}
+
+	iv_work_pool_submit_work(&pool, &items[0]);
+	while (!started)
+		usleep(1000);
+
+	submitted = 1;
+	if (plain_first && !iv_work_pool_submit_work(&pool, &items[1]))
+		submitted++;
+
+	IV_WORK_GROUP_INIT(&range_group);
+	range_group.cookie = &range_group;
+	range_group.completion = group_complete;
+	if (iv_work_parallel_for(&pool, &range_group, 0, RANGE, 1,
+				 range_fn) < 0) {
+		fprintf(stderr, "iv_work_parallel_for failed\n");
+		return 1;
+	}
+
+	IV_WORK_GROUP_INIT(&fork_group);
+	fork_group.cookie = &fork_group;
+	fork_group.completion = group_complete;
+	for (i = 0; i < NUM_SUBTASKS; i++) {
+		IV_WORK_ITEM_INIT(&subtasks[i]);
+		subtasks[i].work = subtask;
+		subtasks[i].completion = subtask_complete;
+		iv_work_group_fork(&pool, &fork_group, &subtasks[i]);
+	}
+	iv_work_group_join(&fork_group);
+
+	if (!iv_work_pool_submit_work(&pool, &items[2]))
+		submitted++;
+
+	expected = submitted;
+
+	iv_main();
+
+	iv_deinit();
+
+	if (plain_first) {
+		if (submitted != 3 || dropped != 1 ||
+		    items[1].status != IV_WORK_STATUS_DROPPED ||
+		    items[2].status != IV_WORK_STATUS_DONE) {
+			fprintf(stderr, "groups: submitted %d, dropped %d\n",
+				submitted, dropped);
+			return 1;
+		}
+	} else if (submitted != 1 || dropped) {
+		fprintf(stderr, "groups only: submitted %d, dropped %d\n",
+			submitted, dropped);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main()
+{
+	alarm(60);
+
+	if (run(IV_WORK_QUEUE_REJECT))
+		return 1;
+
+	if (run(IV_WORK_QUEUE_DROP_OLDEST))
+		return 1;
+
+	if (run(IV_WORK_QUEUE_NOTIFY))
+		return 1;
+
+	if (run_groups(1))
+		return 1;
+
+	if (run_groups(0))
+		return 1;
+
+	return 0;
+}
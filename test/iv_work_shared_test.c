@@ -0,0 +1,147 @@
+/*
+ * ivykis, an event handling library
+ * Copyright (C) 2026 ivykis contributors
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License version
+ * 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License version 2.1 for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License version 2.1 along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street - Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <iv.h>
+#include <iv_thread.h>
+#include <iv_work.h>
+
+#define NUM_LOOPS	8
+#define NUM_ITEMS	1000
+#define MAX_THREADS	4
+
+struct loop {
+	unsigned long		tid;
+	int			completed;
+	int			canceled;
+	struct iv_work_item	items[NUM_ITEMS];
+};
+
+static struct iv_work_pool pool;
+static struct loop loops[NUM_LOOPS];
+static int running_threads;
+static int max_running_threads;
+
+static void thread_start(void *cookie)
+{
+	int running;
+
+	running = __sync_add_and_fetch(&running_threads, 1);
+	if (running > max_running_threads)
+		max_running_threads = running;
+}
+
+static void thread_stop(void *cookie)
+{
+	__sync_sub_and_fetch(&running_threads, 1);
+}
+
+static void work(void *cookie)
+{
+}
+
+static void work_complete(void *cookie)
+{
+	struct loop *l = cookie;
+
+	if (iv_thread_get_id() != l->tid) {
+		fprintf(stderr, "completion delivered to the wrong thread\n");
+		exit(1);
+	}
+
+	l->completed++;
+}
+
+static void loop_thread(void *cookie)
+{
+	struct loop *l = cookie;
+	int i;
+
+	iv_init();
+
+	l->tid = iv_thread_get_id();
+	l->completed = 0;
+	l->canceled = 0;
+
+	for (i = 0; i < NUM_ITEMS; i++) {
+		IV_WORK_ITEM_INIT(&l->items[i]);
+		l->items[i].cookie = l;
+		l->items[i].work = work;
+		l->items[i].completion = work_complete;
+		iv_work_pool_submit_work(&pool, &l->items[i]);
+	}
+
+	/*
+	 * Race cancellations against the pool's threads picking up
+	 * and completing items.  Items that were canceled silently
+	 * won't be completed.
+	 */
+	for (i = 0; i < NUM_ITEMS; i += 2) {
+		if (!iv_work_pool_cancel(&l->items[i],
+					 IV_WORK_CANCEL_FLAG_SILENT))
+			l->canceled++;
+	}
+
+	iv_main();
+
+	iv_deinit();
+}
+
+int main()
+{
+	int i;
+
+	alarm(60);
+
+	iv_init();
+
+	IV_WORK_POOL_INIT(&pool);
+	pool.max_threads = MAX_THREADS;
+	pool.thread_start = thread_start;
+	pool.thread_stop = thread_stop;
+	pool.shared = 1;
+	iv_work_pool_create(&pool);
+
+	for (i = 0; i < NUM_LOOPS; i++)
+		iv_thread_create("loop", loop_thread, &loops[i]);
+
+	iv_main();
+
+	iv_work_pool_put(&pool);
+
+	iv_deinit();
+
+	for (i = 0; i < NUM_LOOPS; i++) {
+		if (loops[i].completed + loops[i].canceled != NUM_ITEMS) {
+			fprintf(stderr, "loop %d only completed %d items "
+				"and canceled %d\n", i, loops[i].completed,
+				loops[i].canceled);
+			return 1;
+		}
+	}
+
+	if (max_running_threads > MAX_THREADS) {
+		fprintf(stderr, "pool ran %d threads (vs %d)\n",
+			max_running_threads, MAX_THREADS);
+		return 1;
+	}
+
+	return 0;
+}
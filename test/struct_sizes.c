@@ -20,6 +20,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#define IV_INLINE_FASTPATH
 #include <iv.h>
 #include "../iv_private.h"
 #ifndef _WIN32
@@ -28,12 +31,62 @@
 #include "../iv_handle_private.h"
 #endif
 
-int main()
+#define CHECK_OFFSET(pub, priv, pubfield, privfield)			\
+	if (offsetof(pub, pubfield) != offsetof(priv, privfield)) {	\
+		fprintf(stderr, #pub "." #pubfield ": %d\n",		\
+			(int)offsetof(pub, pubfield));			\
+		fprintf(stderr, #priv "." #privfield ": %d\n",		\
+			(int)offsetof(priv, privfield));		\
+		fprintf(stderr, "\t=> MISMATCH\n");			\
+		fprintf(stderr, "\n");					\
+		fail = 1;						\
+	}
+
+/*
+ * Check that the structures used by the IV_INLINE_FASTPATH inline
+ * functions in iv.h match the internal structure layouts.
+ */
+static int check_inline_fastpath(void)
 {
 	int fail;
 
 	fail = 0;
 
+	CHECK_OFFSET(struct __iv_loop, struct iv_state, now, time);
+	CHECK_OFFSET(struct __iv_loop, struct iv_state, now_valid, time_valid);
+	CHECK_OFFSET(struct __iv_loop, struct iv_state, numobjs, numobjs);
+	CHECK_OFFSET(struct __iv_loop, struct iv_state, tasks, tasks);
+	CHECK_OFFSET(struct __iv_task, struct iv_task_, priority, priority);
+	CHECK_OFFSET(struct __iv_task, struct iv_task_, list, list);
+	CHECK_OFFSET(struct __iv_timer, struct iv_timer_, index, index);
+
+#ifndef _WIN32
+	{
+		union {
+			struct iv_fd_	priv;
+			struct __iv_fd	pub;
+		} fd;
+
+		memset(&fd, 0, sizeof(fd));
+		fd.priv.registered = 1;
+		if (!fd.pub.registered) {
+			fprintf(stderr, "struct __iv_fd.registered\n");
+			fprintf(stderr, "\t=> MISMATCH\n");
+			fprintf(stderr, "\n");
+			fail = 1;
+		}
+	}
+#endif
+
+	return fail;
+}
+
+int main()
+{
+	int fail;
+
+	fail = check_inline_fastpath();
+
 #ifndef _WIN32
 	if (sizeof(struct iv_fd) < sizeof(struct iv_fd_)) {
 		fprintf(stderr, "struct iv_fd: %d\n",
@@ -44,6 +97,16 @@ int main()
 		fprintf(stderr, "\n");
 		fail = 1;
 	}
+
+	if (sizeof(struct iv_fd_group) < sizeof(struct iv_fd_group_)) {
+		fprintf(stderr, "struct iv_fd_group: %d\n",
+			(int)sizeof(struct iv_fd_group));
+		fprintf(stderr, "struct iv_fd_group_: %d\n",
+			(int)sizeof(struct iv_fd_group_));
+		fprintf(stderr, "\t=> TOO SMALL\n");
+		fprintf(stderr, "\n");
+		fail = 1;
+	}
 #else
 	if (sizeof(struct iv_handle) < sizeof(struct iv_handle_)) {
 		fprintf(stderr, "struct iv_handle: %d\n",
@@ -56,6 +119,16 @@ int main()
 	}
 #endif
 
+	if (sizeof(struct iv_hook) < sizeof(struct iv_hook_)) {
+		fprintf(stderr, "struct iv_hook: %d\n",
+			(int)sizeof(struct iv_hook));
+		fprintf(stderr, "struct iv_hook_: %d\n",
+			(int)sizeof(struct iv_hook_));
+		fprintf(stderr, "\t=> TOO SMALL\n");
+		fprintf(stderr, "\n");
+		fail = 1;
+	}
+
 	if (sizeof(struct iv_task) < sizeof(struct iv_task_)) {
 		fprintf(stderr, "struct iv_task: %d\n",
 			(int)sizeof(struct iv_task));